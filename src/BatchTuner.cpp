@@ -0,0 +1,127 @@
+#include "BatchTuner.h"
+
+#include <cpprest/json.h>
+
+#include <algorithm>
+
+#include "logging/Logging.h"
+
+BatchTuner::BatchTuner(size_t batch_size, int linger_ms)
+    : m_batch_size(std::max<size_t>(1, batch_size)),
+      m_linger_ms(std::max(0, linger_ms)),
+      m_last_tune(std::chrono::steady_clock::now()) {}
+
+void BatchTuner::enable(int target_latency_ms, size_t min_batch_size, size_t max_batch_size) {
+    m_adaptive = true;
+    m_target_latency_ms = std::max(1, target_latency_ms);
+    m_min_batch_size = std::max<size_t>(1, min_batch_size);
+    m_max_batch_size = std::max(m_min_batch_size, max_batch_size);
+    m_batch_size = std::clamp(m_batch_size.load(), m_min_batch_size, m_max_batch_size);
+    m_linger_ms = std::min(m_linger_ms.load(), m_target_latency_ms / 2);
+    Logging::INFO("Tuning batches of " + std::to_string(m_min_batch_size) + " to " + std::to_string(m_max_batch_size) +
+                      " messages towards a latency of " + std::to_string(m_target_latency_ms) + " ms",
+                  m_name);
+}
+
+/*
+The decode rate is pool wide, while every consumer fills batches of its own
+*/
+void BatchTuner::set_consumers(size_t consumers) { m_consumers = std::max<size_t>(1, consumers); }
+
+bool BatchTuner::adaptive() const { return m_adaptive; }
+
+size_t BatchTuner::batch_size() const { return m_batch_size.load(); }
+
+std::chrono::milliseconds BatchTuner::linger() const { return std::chrono::milliseconds(m_linger_ms.load()); }
+
+/*
+Fetch settings for a target latency. A broker holds a fetch for up to fetch.wait.max.ms when it has less than
+fetch.min.bytes, so that is kept well below the target; the prefetch queue is kept small enough that messages do
+not wait in it for long.
+*/
+std::map<std::string, std::string> BatchTuner::fetch_defaults(int target_latency_ms) {
+    int fetch_wait_ms = std::clamp(target_latency_ms / 4, 1, 500);
+    return {
+        {"fetch.wait.max.ms", std::to_string(fetch_wait_ms)},
+        {"fetch.min.bytes", "1"},
+        {"queued.max.messages.kbytes", target_latency_ms < 1000 ? "16384" : "65536"},
+    };
+}
+
+/*
+Serves librdkafka's statistics, and its errors and logs, which no longer go to stderr once an event callback is
+configured
+*/
+void BatchTuner::event_cb(RdKafka::Event &event) {
+    switch (event.type()) {
+        case RdKafka::Event::EVENT_STATS:
+            read_stats(event.str());
+            break;
+        case RdKafka::Event::EVENT_ERROR:
+            LOG_PER_SECOND(ERROR, m_name, 1, "{}: {}", RdKafka::err2str(event.err()), event.str());
+            break;
+        case RdKafka::Event::EVENT_LOG:
+            if (event.severity() <= RdKafka::Event::EVENT_SEVERITY_WARNING) {
+                LOG_PER_SECOND(WARN, m_name, 1, "{}: {}", event.fac(), event.str());
+            } else {
+                LOG_DEBUG(m_name, "{}: {}", event.fac(), event.str());
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+Sums up the consumer lag of every partition that has one
+*/
+void BatchTuner::read_stats(const std::string &json) {
+    int64_t lag = 0;
+    try {
+        web::json::value stats = web::json::value::parse(json);
+        if (!stats.has_field("topics")) {
+            return;
+        }
+        for (const auto &[topic, topic_stats] : stats.at("topics").as_object()) {
+            if (!topic_stats.has_field("partitions")) {
+                continue;
+            }
+            for (const auto &[partition, partition_stats] : topic_stats.at("partitions").as_object()) {
+                if (partition == "-1" || !partition_stats.has_field("consumer_lag")) {
+                    continue;
+                }
+                lag += std::max<int64_t>(0, partition_stats.at("consumer_lag").as_number().to_int64());
+            }
+        }
+    } catch (const std::exception &e) {
+        LOG_PER_SECOND(WARN, m_name, 1, "Could not read statistics: {}", e.what());
+        return;
+    }
+    m_lag = lag;
+}
+
+/*
+Called about once a second with the number of messages the decode workers have processed so far
+*/
+void BatchTuner::tune(uint64_t processed) {
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_last_tune).count();
+    if (!m_adaptive || elapsed < 1000) {
+        return;
+    }
+
+    uint64_t rate = (processed - m_last_processed) * 1000 / elapsed;
+    int64_t lag = m_lag.load();
+    bool falling_behind = lag > 0 && m_last_lag >= 0 && lag > m_last_lag;
+    m_last_processed = processed;
+    m_last_lag = lag;
+    m_last_tune = now;
+
+    size_t batch_size = m_batch_size.load();
+    size_t tuned = falling_behind ? batch_size * 2 : rate * m_target_latency_ms / 1000 / m_consumers.load();
+    tuned = std::clamp(tuned, m_min_batch_size, m_max_batch_size);
+    if (tuned != batch_size) {
+        m_batch_size = tuned;
+        LOG_DEBUG(m_name, "Batch size {} -> {} at {} messages/s, lag {}", batch_size, tuned, rate, lag);
+    }
+}
@@ -0,0 +1,54 @@
+/**
+ * Sizes the batches the consumers hand off to the DecodePool.
+ *
+ * By default the batch size and linger are the configured ones. Once enabled, the batch size is tuned every second
+ * towards a target latency, from the consumer lag in librdkafka's statistics and the rate at which the decode
+ * workers process messages: while the lag keeps growing the batch size is doubled, up to max_batch_size, to catch up;
+ * otherwise batches hold each consumer's share of what the workers process within the target latency, given the
+ * number of consumers that hand off batches (see set_consumers()). Linger is capped at half the target.
+ *
+ * librdkafka's own fetch settings cannot be changed once a handle has been created, so they are only derived from
+ * the target latency at startup (see fetch_defaults()).
+ **/
+#ifndef BATCH_TUNER_H
+#define BATCH_TUNER_H
+
+#include <librdkafka/rdkafkacpp.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+
+class BatchTuner : public RdKafka::EventCb {
+   public:
+    BatchTuner(size_t batch_size, int linger_ms);
+    BatchTuner(const BatchTuner &) = delete;
+    void operator=(const BatchTuner &) = delete;
+    void enable(int target_latency_ms, size_t min_batch_size, size_t max_batch_size);
+    void set_consumers(size_t consumers);
+    bool adaptive() const;
+    size_t batch_size() const;
+    std::chrono::milliseconds linger() const;
+    void event_cb(RdKafka::Event &event) override;
+    void tune(uint64_t processed);
+
+    static std::map<std::string, std::string> fetch_defaults(int target_latency_ms);
+
+   private:
+    const std::string m_name = "BatchTuner";
+    bool m_adaptive = false;
+    int m_target_latency_ms = 0;
+    size_t m_min_batch_size = 1;
+    size_t m_max_batch_size = 1;
+    std::atomic<size_t> m_consumers = 1;
+    std::atomic<size_t> m_batch_size;
+    std::atomic<int> m_linger_ms;
+    std::atomic<int64_t> m_lag = -1;
+    int64_t m_last_lag = -1;
+    uint64_t m_last_processed = 0;
+    std::chrono::steady_clock::time_point m_last_tune;
+    void read_stats(const std::string &json);
+};
+
+#endif
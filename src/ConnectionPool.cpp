@@ -0,0 +1,72 @@
+#include "ConnectionPool.h"
+
+#include <algorithm>
+
+#include "logging/Logging.h"
+
+static std::string name = "ConnectionPool";
+
+ConnectionPool::Lease::Lease(ConnectionPool &pool, std::unique_ptr<pqxx::connection> conn)
+    : m_pool(pool), m_conn(std::move(conn)) {}
+
+pqxx::connection &ConnectionPool::Lease::operator*() const { return *m_conn; }
+
+pqxx::connection *ConnectionPool::Lease::operator->() const { return m_conn.get(); }
+
+ConnectionPool::Lease::~Lease() { m_pool.release(std::move(m_conn)); }
+
+/*
+All connections are opened up front, so a wrong DSN fails at startup rather than on the first batch
+*/
+ConnectionPool::ConnectionPool(const std::string &dsn, size_t size, Prepare prepare)
+    : m_dsn(dsn), m_size(std::max<size_t>(1, size)), m_prepare(std::move(prepare)) {
+    for (size_t i = 0; i < m_size; ++i) {
+        m_idle.push_back(connect());
+    }
+}
+
+std::unique_ptr<pqxx::connection> ConnectionPool::connect() {
+    auto conn = std::make_unique<pqxx::connection>(m_dsn);
+    m_prepare(*conn);
+    return conn;
+}
+
+/*
+Blocks until a connection is idle
+*/
+ConnectionPool::Lease ConnectionPool::acquire() {
+    std::unique_ptr<pqxx::connection> conn;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return !m_idle.empty(); });
+        conn = std::move(m_idle.back());
+        m_idle.pop_back();
+    }
+
+    if (!conn->is_open()) {
+        try {
+            conn = connect();
+        } catch (const std::exception &e) {
+            // Hand out the closed connection; callers see that it is not open and fail the batch
+            LOG_PER_SECOND(ERROR, name, 1, "Could not reconnect to database: {}", e.what());
+        }
+    }
+
+    return Lease(*this, std::move(conn));
+}
+
+void ConnectionPool::release(std::unique_ptr<pqxx::connection> conn) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_idle.push_back(std::move(conn));
+    }
+    m_cv.notify_one();
+}
+
+size_t ConnectionPool::size() const { return m_size; }
+
+ConnectionPool::~ConnectionPool() {
+    for (auto &conn : m_idle) {
+        conn->close();
+    }
+}
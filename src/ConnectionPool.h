@@ -0,0 +1,56 @@
+/**
+ * Fixed number of PostgreSQL connections shared by the threads that write to the database.
+ *
+ * pqxx connections must not be used by two threads at once. Rather than serialising every writer on a single
+ * connection, a thread checks a connection out with acquire() for the duration of a batch and the Lease hands it
+ * back when it goes out of scope. Every connection is prepared with the same statements when it is opened, and a
+ * connection that has been closed is reopened the next time it is checked out.
+ **/
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <pqxx/pqxx>
+#include <string>
+#include <vector>
+
+class ConnectionPool {
+   public:
+    using Prepare = std::function<void(pqxx::connection &)>;
+
+    class Lease {
+       public:
+        Lease(ConnectionPool &pool, std::unique_ptr<pqxx::connection> conn);
+        Lease(const Lease &) = delete;
+        void operator=(const Lease &) = delete;
+        pqxx::connection &operator*() const;
+        pqxx::connection *operator->() const;
+        ~Lease();
+
+       private:
+        ConnectionPool &m_pool;
+        std::unique_ptr<pqxx::connection> m_conn;
+    };
+
+    ConnectionPool(const std::string &dsn, size_t size, Prepare prepare);
+    ConnectionPool(const ConnectionPool &) = delete;
+    void operator=(const ConnectionPool &) = delete;
+    Lease acquire();
+    size_t size() const;
+    ~ConnectionPool();
+
+   private:
+    const std::string m_dsn;
+    const size_t m_size;
+    const Prepare m_prepare;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::unique_ptr<pqxx::connection>> m_idle;
+    std::unique_ptr<pqxx::connection> connect();
+    void release(std::unique_ptr<pqxx::connection> conn);
+};
+
+#endif
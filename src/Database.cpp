@@ -1,60 +1,102 @@
 #include "Database.h"
 
-#include <iostream>
+#include "logging/Logging.h"
 
-Database::Database(const std::string *url) : m_conn(*url) { prepare_insert(m_conn); }
+static std::string name = "Database";
 
-Database &Database::instance_impl(const std::string *url = nullptr) {
-    static Database i{url};
+Database::Database(const std::string *url, size_t pool_size, size_t cache_capacity)
+    : m_pool(*url, pool_size, [this](pqxx::connection &conn) { prepare_insert(conn); }),
+      m_object_ids(cache_capacity) {
+    warm_object_ids();
+}
+
+Database &Database::instance_impl(const std::string *url = nullptr, size_t pool_size = 0, size_t cache_capacity = 0) {
+    static Database i{url, pool_size, cache_capacity};
 
     return i;
 }
 
-void Database::init(const std::string &url) { instance_impl(&url); }
+void Database::init(const std::string &url, size_t pool_size, size_t cache_capacity) {
+    instance_impl(&url, pool_size, cache_capacity);
+}
 
 Database &Database::instance() {
     Database &i = instance_impl();
     return i;
 }
 
+const ObjectIdCache &Database::object_ids() const { return m_object_ids; }
+
+/*
+Loads the ids of the newest objects, which are the most likely to show up again, into the cache
+*/
+void Database::warm_object_ids() {
+    if (m_object_ids.capacity() == 0) {
+        return;
+    }
+
+    ConnectionPool::Lease conn = m_pool.acquire();
+    pqxx::work transaction{*conn};
+    pqxx::result r = transaction.exec_params(m_newest_object_ids_stmt, m_object_ids.capacity());
+    transaction.commit();
+    for (auto const &row : r) {
+        m_object_ids.put(row[1].as<std::string>(), row[0].as<int>());
+    }
+}
+
 void Database::prepare_insert(pqxx::connection &conn) {
     conn.prepare("insert_object", m_insert_object_stmt);
     conn.prepare("insert_relationship", m_insert_relationship_stmt);
     conn.prepare("select_object_id", m_object_id_for_name_stmt);
+
+    // Temporary tables live as long as the session, so the staging table is created once per connection
+    pqxx::nontransaction staging{conn};
+    staging.exec(m_create_names_staging_stmt);
+    staging.exec(m_create_relationships_staging_stmt);
+    conn.prepare("insert_staged_objects", m_insert_staged_objects_stmt);
+    conn.prepare("select_staged_object_ids", m_staged_object_ids_stmt);
+    conn.prepare("insert_staged_relationships", m_insert_staged_relationships_stmt);
 }
 
 int Database::get_object_id(const std::string &object_name) {
-    if (m_conn.is_open()) {
-        pqxx::work transaction{m_conn};
+    int id;
+    if (m_object_ids.get(object_name, id)) {
+        return id;
+    }
+
+    ConnectionPool::Lease conn = m_pool.acquire();
+    if (conn->is_open()) {
+        pqxx::work transaction{*conn};
         pqxx::result r = transaction.exec_prepared("select_object_id", object_name);
         transaction.commit();
         for (auto const &row : r) {
             const pqxx::field field = row[0];
-            return field.as<int>();
+            id = field.as<int>();
+            m_object_ids.put(object_name, id);
+            return id;
         }
     } else {
-        std::cout << "Database connection is not open!" << std::endl;
+        LOG_PER_SECOND(ERROR, name, 1, "Database connection is not open");
     }
     return 0;
 }
 
 bool Database::insert_object(const std::string &object_name, const std::string &object_type,
                              const std::string &created_at) {
-    if (m_conn.is_open()) {
-        pqxx::work transaction{m_conn};
+    ConnectionPool::Lease conn = m_pool.acquire();
+    if (conn->is_open()) {
+        pqxx::work transaction{*conn};
         pqxx::result r;
         for (int i = 0; i < 2; i++) {
             r = transaction.exec_prepared("insert_object", object_name, object_type, created_at);
+            for (auto const &row : r) {
+                m_object_ids.put(object_name, row[0].as<int>());
+            }
         }
         transaction.commit();
 
-        // for (auto const &row : r) {
-        //     const pqxx::field field = row[0];
-        //     return field.as<int>();
-        // }
-
     } else {
-        std::cout << "Database connection is not open!" << std::endl;
+        LOG_PER_SECOND(ERROR, name, 1, "Database connection is not open");
         return false;
     }
 
@@ -62,18 +104,105 @@ bool Database::insert_object(const std::string &object_name, const std::string &
 }
 
 bool Database::insert_relationship(const int source_id, const int target_id, const std::string &relationship_name) {
-    if (m_conn.is_open()) {
-        pqxx::work transaction{m_conn};
+    ConnectionPool::Lease conn = m_pool.acquire();
+    if (conn->is_open()) {
+        pqxx::work transaction{*conn};
         pqxx::result r;
         for (int i = 0; i < 2; i++) {
             r = transaction.exec_prepared("insert_relationship", source_id, target_id, relationship_name);
         }
         transaction.commit();
     } else {
-        std::cout << "Database connection is not open!" << std::endl;
+        LOG_PER_SECOND(ERROR, name, 1, "Database connection is not open");
         return false;
     }
 
     return true;
 }
-Database::~Database() { m_conn.close(); }
+
+/*
+Looks up the id of every subject and object of the batch in the cache. The names that are not cached are streamed
+into the staging table with COPY and inserted with one statement, after which the ids of new and existing objects
+alike are selected with another. Returns the selected rows, which are cached once the transaction has been
+committed. Both are skipped when every name is cached.
+*/
+pqxx::result Database::resolve_object_ids(pqxx::work &transaction, const std::vector<Triple> &triples, size_t count,
+                                          const std::string &object_type, const std::string &created_at,
+                                          std::unordered_map<std::string_view, int> &ids) {
+    std::vector<std::string_view> missing;
+    for (size_t i = 0; i < count; ++i) {
+        for (const std::string *name : {&triples[i].subject, &triples[i].object}) {
+            if (ids.count(*name)) {
+                continue;
+            }
+            int id;
+            if (m_object_ids.get(*name, id)) {
+                ids.emplace(*name, id);
+            } else {
+                ids.emplace(*name, 0);
+                missing.push_back(*name);
+            }
+        }
+    }
+    if (missing.empty()) {
+        return pqxx::result();
+    }
+
+    pqxx::stream_to stream = pqxx::stream_to::table(transaction, {"names_staging"}, {"object_name"});
+    for (std::string_view name : missing) {
+        stream.write_values(name);
+    }
+    stream.complete();
+
+    transaction.exec_prepared("insert_staged_objects", object_type, created_at);
+    pqxx::result r = transaction.exec_prepared("select_staged_object_ids");
+    for (auto const &row : r) {
+        auto found = ids.find(row[1].view());
+        if (found != ids.end()) {
+            found->second = row[0].as<int>();
+        }
+    }
+    return r;
+}
+
+/*
+Persists the first count triples in a single transaction on one pooled connection: once the ids of all subjects
+and objects are resolved, the relationships are streamed into their staging table with COPY and inserted with one
+statement. The staging tables are emptied on commit.
+*/
+bool Database::insert_triples(const std::vector<Triple> &triples, size_t count, const std::string &object_type,
+                              const std::string &created_at) {
+    ConnectionPool::Lease conn = m_pool.acquire();
+    if (!conn->is_open()) {
+        LOG_PER_SECOND(ERROR, name, 1, "Database connection is not open");
+        return false;
+    }
+
+    try {
+        pqxx::work transaction{*conn};
+
+        std::unordered_map<std::string_view, int> ids;
+        pqxx::result r = resolve_object_ids(transaction, triples, count, object_type, created_at, ids);
+
+        pqxx::stream_to stream = pqxx::stream_to::table(transaction, {"relationships_staging"},
+                                                        {"source_id", "target_id", "relationship_name"});
+        for (size_t i = 0; i < count; ++i) {
+            stream.write_values(ids[triples[i].subject], ids[triples[i].object], triples[i].predicate);
+        }
+        stream.complete();
+
+        transaction.exec_prepared("insert_staged_relationships");
+        transaction.commit();
+
+        for (auto const &row : r) {
+            m_object_ids.put(row[1].as<std::string>(), row[0].as<int>());
+        }
+    } catch (const std::exception &e) {
+        LOG_PER_SECOND(ERROR, name, 1, "Failed to persist triples: {}", e.what());
+        return false;
+    }
+
+    return true;
+}
+
+Database::~Database() {}
@@ -4,6 +4,19 @@
 #include <iostream>
 #include <pqxx/pqxx>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ConnectionPool.h"
+#include "ObjectIdCache.h"
+
+struct Triple {
+    std::string subject;
+    std::string predicate;
+    std::string object;
+};
+
 class Database {
    public:
     ~Database();
@@ -11,14 +24,24 @@ class Database {
     bool insert_object(const std::string &object_name, const std::string &object_type, const std::string &created_at);
     int get_object_id(const std::string &object_name);
     bool insert_relationship(const int source_id, const int target_id, const std::string &relationship_name);
+    bool insert_triples(const std::vector<Triple> &triples, size_t count, const std::string &object_type,
+                        const std::string &created_at);
+    const ObjectIdCache &object_ids() const;
     static Database &instance();
-    static void init(const std::string &url);
+    static void init(const std::string &url, size_t pool_size = DEFAULT_POOL_SIZE,
+                     size_t cache_capacity = DEFAULT_CACHE_CAPACITY);
 
    private:
-    Database(const std::string *url);
+    static constexpr size_t DEFAULT_POOL_SIZE = 4;
+    static constexpr size_t DEFAULT_CACHE_CAPACITY = 100000;
+
+    Database(const std::string *url, size_t pool_size, size_t cache_capacity);
     void prepare_insert(pqxx::connection &conn);
-    static Database &instance_impl(const std::string *url);
-    pqxx::connection m_conn;
+    void warm_object_ids();
+    pqxx::result resolve_object_ids(pqxx::work &transaction, const std::vector<Triple> &triples, size_t count,
+                                    const std::string &object_type, const std::string &created_at,
+                                    std::unordered_map<std::string_view, int> &ids);
+    static Database &instance_impl(const std::string *url, size_t pool_size, size_t cache_capacity);
 
     const std::string m_insert_object_stmt{
         "INSERT INTO objects(object_name, object_type, created_at) VALUES ($1, $2, $3::date) ON CONFLICT ON CONSTRAINT "
@@ -26,8 +49,42 @@ class Database {
 
     const std::string m_object_id_for_name_stmt{"SELECT id FROM objects WHERE object_name = $1"};
 
+    // The newest objects, oldest first so that the newest end up as the most recently used cache entries
+    const std::string m_newest_object_ids_stmt{
+        "SELECT id, object_name FROM (SELECT id, object_name FROM objects ORDER BY id DESC LIMIT $1) newest ORDER BY "
+        "id"};
+
     const std::string m_insert_relationship_stmt{
         "INSERT INTO relationships(source_id, target_id, relationship_name) VALUES ($1, $2, $3) ON CONFLICT ON "
         "CONSTRAINT relationships_unique_constraint DO NOTHING"};
+
+    /*
+    The names of a batch that are not cached and its relationships are copied into per-connection staging tables and
+    inserted with one set-based statement each. Rows are inserted in the order of the unique constraint, so that
+    workers inserting overlapping batches take their locks in the same order and cannot deadlock. Objects that exist
+    already are left alone; the ids of new and existing objects alike are selected once the new ones are inserted.
+    */
+    const std::string m_create_names_staging_stmt{
+        "CREATE TEMP TABLE IF NOT EXISTS names_staging (object_name text) ON COMMIT DELETE ROWS"};
+
+    const std::string m_create_relationships_staging_stmt{
+        "CREATE TEMP TABLE IF NOT EXISTS relationships_staging (source_id integer, target_id integer, "
+        "relationship_name text) ON COMMIT DELETE ROWS"};
+
+    const std::string m_insert_staged_objects_stmt{
+        "INSERT INTO objects(object_name, object_type, created_at) SELECT DISTINCT object_name, $1, $2::date FROM "
+        "names_staging ORDER BY object_name ON CONFLICT ON CONSTRAINT objects_unique_constraint DO NOTHING"};
+
+    const std::string m_staged_object_ids_stmt{
+        "SELECT id, object_name FROM objects WHERE object_name IN (SELECT object_name FROM names_staging)"};
+
+    const std::string m_insert_staged_relationships_stmt{
+        "INSERT INTO relationships(source_id, target_id, relationship_name) SELECT DISTINCT source_id, target_id, "
+        "relationship_name FROM relationships_staging ORDER BY source_id, target_id, relationship_name ON CONFLICT ON "
+        "CONSTRAINT relationships_unique_constraint DO NOTHING"};
+
+    // Declared after the statements, which the pool prepares on every connection it opens
+    ConnectionPool m_pool;
+    ObjectIdCache m_object_ids;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,429 @@
+#include "DecodePool.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "ThreadGuard.h"
+#include "logging/Logging.h"
+#include "sinks/SinkFactory.h"
+
+static std::string name = "DecodePool";
+
+static bool wait_until(const std::future<void> &future, std::chrono::steady_clock::time_point deadline) {
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+        future.wait();
+        return true;
+    }
+    return future.wait_until(deadline) == std::future_status::ready;
+}
+
+DecodeWorker::DecodeWorker(size_t id, DecodeMode mode, const std::vector<SinkConfig> &sink_configs,
+                           const std::map<std::string, DecodeMode> &topic_modes, const OffsetCallback &on_durable)
+    : m_name("DecodeWorker[" + std::to_string(id) + "]"),
+      m_id(id),
+      m_mode(mode),
+      m_sink_configs(sink_configs),
+      m_topic_modes(topic_modes),
+      m_on_durable(on_durable) {}
+
+/*
+The sinks are built here rather than in the constructor, so that a bad sink configuration is reported instead of
+thrown out of the pool's constructor.
+*/
+bool DecodeWorker::start() {
+    try {
+        m_sink = SinkFactory().create(m_name, m_id, m_sink_configs);
+    } catch (const std::exception &e) {
+        Logging::ERROR(std::string("Could not create sinks: ") + e.what(), m_name);
+        return false;
+    }
+
+    m_t = std::make_unique<std::thread>(&DecodeWorker::run, this);
+    Logging::INFO("Started", m_name);
+    return true;
+}
+
+void DecodeWorker::join() const {
+    if (m_t) {
+        ThreadGuard g(*m_t);
+    }
+}
+
+/*
+The queue depth and the congested flag change together under m_relieved_mutex, so the flag can never be left set
+by an enqueue that raced with the dequeue that relieves the worker
+*/
+void DecodeWorker::enqueue(MessageBatch batch) {
+    size_t messages = batch.size();
+    bool congested = false;
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(m_relieved_mutex);
+        queued = m_queued += messages;
+        congested = m_high_watermark && queued >= m_high_watermark && !m_congested.exchange(true);
+    }
+    if (congested) {
+        Logging::INFO("Congested with " + std::to_string(queued) + " queued messages", m_name);
+    }
+    m_queue.enqueue(DecodeTask{std::move(batch)});
+}
+
+void DecodeWorker::dequeued(size_t messages) {
+    m_processed += messages;
+    bool relieved = false;
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(m_relieved_mutex);
+        queued = m_queued -= messages;
+        relieved = queued <= m_low_watermark && m_congested.exchange(false);
+    }
+    if (relieved) {
+        Logging::INFO("Relieved with " + std::to_string(queued) + " queued messages", m_name);
+        m_relieved_cv.notify_all();
+        if (m_on_relieved) {
+            m_on_relieved();
+        }
+    }
+}
+
+/*
+The drain marker is queued behind every batch that has already been dispatched, so the future is ready once those
+have been written durably and their offsets reported
+*/
+std::future<void> DecodeWorker::drain(const std::vector<TopicPartition> &released) {
+    auto drained = std::make_shared<std::promise<void>>();
+    std::future<void> future = drained->get_future();
+    m_queue.enqueue(DecodeTask{MessageBatch(), std::move(drained), released});
+    return future;
+}
+
+/*
+An empty batch is used as the stop marker. Since it is queued behind every batch that has already been dispatched,
+the worker drains its backlog before it exits.
+*/
+void DecodeWorker::stop() { m_queue.enqueue(DecodeTask()); }
+
+/*
+Batches dequeued from now on are dropped without being written. One that is being written is still finished.
+*/
+void DecodeWorker::abandon() { m_abandoned = true; }
+
+bool DecodeWorker::wait_until_stopped(std::chrono::steady_clock::time_point deadline) const {
+    return wait_until(m_stopped_future, deadline);
+}
+
+size_t DecodeWorker::errors() const { return m_errors.load(); }
+
+/*
+A high watermark of 0 turns backpressure off
+*/
+void DecodeWorker::set_watermarks(size_t high, size_t low) {
+    m_high_watermark = high;
+    m_low_watermark = std::min(low, high);
+}
+
+/*
+Has to be set before the worker is started
+*/
+void DecodeWorker::set_relieved_callback(const std::function<void()> &on_relieved) { m_on_relieved = on_relieved; }
+
+size_t DecodeWorker::queued() const { return m_queued.load(); }
+
+uint64_t DecodeWorker::processed() const { return m_processed.load(); }
+
+bool DecodeWorker::congested() const { return m_congested.load(); }
+
+/*
+Returns whether the worker is no longer congested
+*/
+bool DecodeWorker::wait_until_relieved(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_relieved_mutex);
+    return m_relieved_cv.wait_for(lock, timeout, [this]() { return !m_congested.load(); });
+}
+
+KafkaConsumerCallback &DecodeWorker::consumer_cb_for(const RdKafka::Message *message) {
+    auto found = m_consumer_cbs.find(message->topic());
+    if (found == m_consumer_cbs.end()) {
+        auto topic_mode = m_topic_modes.find(message->topic_name());
+        DecodeMode mode = topic_mode == m_topic_modes.end() ? m_mode : topic_mode->second;
+        auto consumer_cb = std::make_unique<KafkaConsumerCallback>(message->topic_name(), mode, m_sink.get());
+        found = m_consumer_cbs.emplace(message->topic(), std::move(consumer_cb)).first;
+    }
+    return *found->second;
+}
+
+/*
+Messages that could not be decoded still count as handled, so that a bad message does not hold back the offsets of
+its partition forever. Messages that could not be written do not.
+*/
+void DecodeWorker::process(const MessageBatch &batch) {
+    PartitionOffsets offsets;
+
+    // Hand each run of messages that belong to the same topic to that topic's callback in one go
+    auto first = batch.begin();
+    while (first != batch.end()) {
+        auto last = std::find_if(first, batch.end(), [first](const RdKafka::Message *message) {
+            return message->topic() != (*first)->topic();
+        });
+        size_t failed = consumer_cb_for(*first).consume_batch(std::span(first, last));
+        if (failed) {
+            size_t errors = m_errors += failed;
+            LOG_PER_SECOND(ERROR, m_name, 1, "Number of failed deserializations: {}", errors);
+        }
+
+        if (m_on_durable) {
+            std::string topic = (*first)->topic_name();
+            for (auto it = first; it != last; ++it) {
+                int64_t &offset = offsets[{topic, (*it)->partition()}];
+                offset = std::max(offset, (*it)->offset() + 1);
+            }
+        }
+        first = last;
+    }
+    if (!m_sink->flush()) {
+        LOG_PER_SECOND(ERROR, m_name, 1, "Could not write a batch of {} messages to all sinks", batch.size());
+        fail(offsets);
+        return;
+    }
+
+    for (const auto &[partition, offset] : offsets) {
+        int64_t &pending = m_pending_offsets[partition];
+        pending = std::max(pending, offset);
+    }
+}
+
+/*
+Stops reporting the offsets of the partitions, including those already pending, since records held for them may be
+lost as well
+*/
+void DecodeWorker::fail(const PartitionOffsets &offsets) {
+    for (const auto &[partition, offset] : offsets) {
+        if (m_failed_partitions.insert(partition).second) {
+            Logging::ERROR("No longer committing " + partition.first + "/" + std::to_string(partition.second) +
+                               " after records of it could not be written",
+                           m_name);
+        }
+    }
+}
+
+void DecodeWorker::report_offsets() {
+    for (const TopicPartition &partition : m_failed_partitions) {
+        m_pending_offsets.erase(partition);
+    }
+    if (m_on_durable && !m_pending_offsets.empty()) {
+        m_on_durable(m_pending_offsets);
+    }
+    m_pending_offsets.clear();
+}
+
+void DecodeWorker::run() {
+    size_t abandoned = 0;
+    for (DecodeTask task = m_queue.dequeue(); !task.batch.empty() || task.drained; task = m_queue.dequeue()) {
+        if (task.drained) {
+            if (!m_sink->sync()) {
+                LOG_ERROR(m_name, "Could not write everything held by the sinks");
+                fail(m_pending_offsets);
+            }
+            report_offsets();
+
+            // Whoever consumes a released partition next starts from its last committed offset
+            for (const TopicPartition &partition : task.released) {
+                m_failed_partitions.erase(partition);
+            }
+            task.drained->set_value();
+            continue;
+        }
+
+        if (m_abandoned.load()) {
+            abandoned += task.batch.size();
+        } else {
+            process(task.batch);
+            if (!m_sink->holds_records()) {
+                report_offsets();
+            }
+        }
+
+        for (RdKafka::Message *message : task.batch) {
+            delete message;
+        }
+        dequeued(task.batch.size());
+    }
+
+    if (abandoned) {
+        Logging::WARN("Abandoned " + std::to_string(abandoned) + " messages, which will be consumed again", m_name);
+    }
+    Logging::INFO("Shutting down", m_name);
+    m_stopped.set_value();
+}
+
+DecodeWorker::~DecodeWorker() {}
+
+DecodePool::DecodePool(size_t workers, DecodeMode mode, const std::vector<SinkConfig> &sink_configs,
+                       const std::map<std::string, DecodeMode> &topic_modes, const OffsetCallback &on_durable) {
+    if (workers == 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < workers; ++i) {
+        m_workers.emplace_back(std::make_unique<DecodeWorker>(i, mode, sink_configs, topic_modes, on_durable));
+    }
+}
+
+bool DecodePool::start() {
+    for (auto &worker : m_workers) {
+        if (!worker->start()) {
+            return false;
+        }
+    }
+    Logging::INFO("Started " + std::to_string(m_workers.size()) + " decode workers", name);
+    return true;
+}
+
+/*
+Sharded by topic name rather than topic handle, so that drain() can find the worker of a partition it only knows
+by name
+*/
+size_t DecodePool::shard(const std::string &topic, int32_t partition) const {
+    size_t h = std::hash<std::string>{}(topic);
+    h ^= std::hash<int32_t>{}(partition) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h % m_workers.size();
+}
+
+size_t DecodePool::shard(const RdKafka::Message *message) const {
+    return shard(message->topic_name(), message->partition());
+}
+
+void DecodePool::dispatch(MessageBatch batch) {
+    if (batch.empty()) {
+        return;
+    }
+
+    // The common case is a batch from a single partition, which goes to its worker as is
+    size_t first_shard = shard(batch.front());
+    bool single_shard = std::all_of(batch.begin(), batch.end(), [this, first_shard](const RdKafka::Message *message) {
+        return shard(message) == first_shard;
+    });
+    if (single_shard) {
+        m_workers[first_shard]->enqueue(std::move(batch));
+        return;
+    }
+
+    std::vector<MessageBatch> shards(m_workers.size());
+    for (RdKafka::Message *message : batch) {
+        shards[shard(message)].push_back(message);
+    }
+    for (size_t i = 0; i < shards.size(); ++i) {
+        if (!shards[i].empty()) {
+            m_workers[i]->enqueue(std::move(shards[i]));
+        }
+    }
+}
+
+/*
+Only the workers the partitions are sharded to are drained; the others carry on. Returns whether they were all
+drained before the deadline.
+*/
+bool DecodePool::drain(const std::vector<TopicPartition> &partitions, std::chrono::steady_clock::time_point deadline) {
+    std::map<size_t, std::vector<TopicPartition>> released;
+    for (const TopicPartition &partition : partitions) {
+        released[shard(partition.first, partition.second)].push_back(partition);
+    }
+
+    std::vector<std::future<void>> drained;
+    for (const auto &[worker, worker_partitions] : released) {
+        drained.push_back(m_workers[worker]->drain(worker_partitions));
+    }
+    bool in_time = true;
+    for (auto &future : drained) {
+        in_time = wait_until(future, deadline) && in_time;
+    }
+    return in_time;
+}
+
+void DecodePool::set_watermarks(size_t high, size_t low) {
+    for (auto &worker : m_workers) {
+        worker->set_watermarks(high, low);
+    }
+}
+
+void DecodePool::set_relieved_callback(const std::function<void()> &on_relieved) {
+    for (auto &worker : m_workers) {
+        worker->set_relieved_callback(on_relieved);
+    }
+}
+
+bool DecodePool::congested(const std::string &topic, int32_t partition) const {
+    return m_workers[shard(topic, partition)]->congested();
+}
+
+bool DecodePool::wait_until_relieved(const std::string &topic, int32_t partition,
+                                     std::chrono::milliseconds timeout) {
+    return m_workers[shard(topic, partition)]->wait_until_relieved(timeout);
+}
+
+void DecodePool::log_queue_depths() const {
+    std::string depths;
+    size_t total = 0;
+    size_t congested = 0;
+    for (const auto &worker : m_workers) {
+        size_t queued = worker->queued();
+        depths += (depths.empty() ? "" : ", ") + std::to_string(queued);
+        total += queued;
+        congested += worker->congested();
+    }
+    Logging::INFO("Queued messages: " + std::to_string(total) + " (" + depths + "), " + std::to_string(congested) +
+                      " of " + std::to_string(m_workers.size()) + " workers congested",
+                  name);
+}
+
+uint64_t DecodePool::processed() const {
+    uint64_t processed = 0;
+    for (const auto &worker : m_workers) {
+        processed += worker->processed();
+    }
+    return processed;
+}
+
+/*
+Every worker makes what has been dispatched to it durable and reports its offsets before it stops. Workers that
+have not got there by the deadline abandon the rest of their queue. Returns whether they all got there in time.
+*/
+bool DecodePool::stop(std::chrono::steady_clock::time_point deadline) {
+    std::vector<std::future<void>> drained;
+    for (auto &worker : m_workers) {
+        drained.push_back(worker->drain());
+        worker->stop();
+    }
+
+    size_t abandoned = 0;
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        if (!wait_until(drained[i], deadline)) {
+            m_workers[i]->abandon();
+            ++abandoned;
+        }
+    }
+    if (abandoned) {
+        Logging::WARN("Not drained in time, " + std::to_string(abandoned) + " of " +
+                          std::to_string(m_workers.size()) + " workers abandon what is still queued",
+                      name);
+    }
+    return abandoned == 0;
+}
+
+/*
+Returns false, without joining any worker, if some have not stopped by the deadline
+*/
+bool DecodePool::join(std::chrono::steady_clock::time_point deadline) const {
+    for (const auto &worker : m_workers) {
+        if (!worker->wait_until_stopped(deadline)) {
+            return false;
+        }
+    }
+    for (const auto &worker : m_workers) {
+        worker->join();
+    }
+    return true;
+}
+
+size_t DecodePool::size() const { return m_workers.size(); }
+
+DecodePool::~DecodePool() {}
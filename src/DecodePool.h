@@ -0,0 +1,143 @@
+/**
+ * Fixed pool of threads that take Avro decode, JSON encode and output off the consuming threads.
+ *
+ * Messages are sharded by topic and partition, so a partition is always handled by the same worker and
+ * per-partition ordering is preserved. The consuming threads only hand off batches of message pointers;
+ * ownership of a dispatched RdKafka::Message passes to the worker, which deletes it once it has been processed.
+ * Every worker writes the decoded records to its own chain of sinks, which it flushes once per batch. Topics can be
+ * decoded in a mode of their own, given in topic_modes.
+ *
+ * Once the sinks have written a batch durably, the worker reports the next offset of each of its partitions to
+ * the OffsetCallback, if one was given. Offsets of records that a sink still holds (see Sink::holds_records) are
+ * reported once it has written them. Once records of a partition could not be written, its offsets are no longer
+ * reported until it is released by a drain, so it is consumed again from its last durable offset rather than
+ * committed past the lost records. drain() waits until everything dispatched for a partition has been written
+ * and reported, which is how a consumer group gives up partitions.
+ *
+ * Workers count the messages queued for them. A worker that has high_watermark messages queued is congested until
+ * it is back down to low_watermark, and consumers pause the partitions sharded to a congested worker, so a slow sink
+ * bounds the backlog instead of letting it grow with the input. Consumers that cannot block on a worker are told
+ * when one is relieved through the callback given to set_relieved_callback().
+ *
+ * stop() drains every worker before stopping it, until a deadline. Once it has passed, workers abandon what is
+ * still queued for them: it is neither written nor reported, so it is consumed again after a restart. A worker
+ * that is stuck in a sink cannot be interrupted, so join() takes a deadline as well and leaves such workers behind;
+ * the process then has to exit without destroying the pool.
+ **/
+#ifndef DECODE_POOL_H
+#define DECODE_POOL_H
+
+#include <librdkafka/rdkafkacpp.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "KafkaConsumerCallback.h"
+#include "SafeQueue.h"
+#include "sinks/Sink.h"
+
+using TopicPartition = std::pair<std::string, int32_t>;
+using PartitionOffsets = std::map<TopicPartition, int64_t>;
+using OffsetCallback = std::function<void(const PartitionOffsets &offsets)>;
+
+/*
+A batch to process. An empty batch with a promise asks the worker to make everything durable and report its
+offsets, after which it no longer owns the released partitions; an empty batch without one asks it to stop.
+*/
+struct DecodeTask {
+    MessageBatch batch;
+    std::shared_ptr<std::promise<void>> drained;
+    std::vector<TopicPartition> released;
+};
+
+class DecodeWorker {
+   public:
+    DecodeWorker(size_t id, DecodeMode mode, const std::vector<SinkConfig> &sink_configs,
+                 const std::map<std::string, DecodeMode> &topic_modes, const OffsetCallback &on_durable);
+    bool start();
+    void join() const;
+    void enqueue(MessageBatch batch);
+    std::future<void> drain(const std::vector<TopicPartition> &released = {});
+    void stop();
+    void abandon();
+    bool wait_until_stopped(std::chrono::steady_clock::time_point deadline) const;
+    size_t errors() const;
+    void set_watermarks(size_t high, size_t low);
+    void set_relieved_callback(const std::function<void()> &on_relieved);
+    size_t queued() const;
+    uint64_t processed() const;
+    bool congested() const;
+    bool wait_until_relieved(std::chrono::milliseconds timeout);
+    ~DecodeWorker();
+
+   private:
+    const std::string m_name;
+    const size_t m_id;
+    const DecodeMode m_mode;
+    const std::vector<SinkConfig> m_sink_configs;
+    const std::map<std::string, DecodeMode> m_topic_modes;
+    const OffsetCallback m_on_durable;
+    SafeQueue<DecodeTask> m_queue;
+    std::unique_ptr<std::thread> m_t;
+    std::promise<void> m_stopped;
+    std::future<void> m_stopped_future = m_stopped.get_future();
+    std::unique_ptr<Sink> m_sink;
+    std::unordered_map<const RdKafka::Topic *, std::unique_ptr<KafkaConsumerCallback>> m_consumer_cbs;
+    std::atomic<size_t> m_errors = 0;
+    PartitionOffsets m_pending_offsets;
+    std::set<TopicPartition> m_failed_partitions;
+    size_t m_high_watermark = 0;
+    size_t m_low_watermark = 0;
+    std::atomic<size_t> m_queued = 0;
+    std::atomic<uint64_t> m_processed = 0;
+    std::atomic<bool> m_congested = false;
+    std::atomic<bool> m_abandoned = false;
+    std::mutex m_relieved_mutex;
+    std::condition_variable m_relieved_cv;
+    std::function<void()> m_on_relieved;
+    void dequeued(size_t messages);
+    KafkaConsumerCallback &consumer_cb_for(const RdKafka::Message *message);
+    void process(const MessageBatch &batch);
+    void fail(const PartitionOffsets &offsets);
+    void report_offsets();
+    void run();
+};
+
+class DecodePool {
+   public:
+    DecodePool(size_t workers, DecodeMode mode = DecodeMode::TRANSCODE,
+               const std::vector<SinkConfig> &sink_configs = {{{"type", "stdout"}}},
+               const std::map<std::string, DecodeMode> &topic_modes = {}, const OffsetCallback &on_durable = {});
+    bool start();
+    void dispatch(MessageBatch batch);
+    bool drain(const std::vector<TopicPartition> &partitions,
+               std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+    void set_watermarks(size_t high, size_t low);
+    void set_relieved_callback(const std::function<void()> &on_relieved);
+    bool congested(const std::string &topic, int32_t partition) const;
+    bool wait_until_relieved(const std::string &topic, int32_t partition, std::chrono::milliseconds timeout);
+    void log_queue_depths() const;
+    uint64_t processed() const;
+    bool stop(std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+    bool join(std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()) const;
+    size_t size() const;
+    ~DecodePool();
+
+   private:
+    std::vector<std::unique_ptr<DecodeWorker>> m_workers;
+    size_t shard(const std::string &topic, int32_t partition) const;
+    size_t shard(const RdKafka::Message *message) const;
+};
+
+#endif
@@ -0,0 +1,229 @@
+#include "EventLoopConsumer.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "ThreadGuard.h"
+#include "logging/Logging.h"
+
+static constexpr int MAX_EVENTS = 64;
+
+/*
+Callbacks of the handle, such as statistics and errors, are served at least this often while nothing else happens
+*/
+static constexpr int POLL_INTERVAL_MS = 1000;
+
+EventLoopConsumer::EventLoopConsumer(RdKafka::Consumer *consumer, DecodePool &pool,
+                                     std::shared_ptr<SignalChannel> sig_channel, std::shared_ptr<BatchTuner> tuner)
+    : m_consumer(consumer),
+      m_pool(pool),
+      m_sig_channel(sig_channel),
+      m_tuner(tuner),
+      m_epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+      m_relieved_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    // The shutdown and relief fds are told apart from the partitions by their data pointer
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = m_sig_channel.get();
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_sig_channel->m_fd, &event);
+    event.data.ptr = this;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_relieved_fd, &event);
+}
+
+/*
+Starts consuming the partition onto a queue of its own, which signals its pipe when messages arrive
+*/
+bool EventLoopConsumer::add(RdKafka::Topic *topic, int32_t partition, int64_t start_offset) {
+    auto p = std::make_unique<Partition>();
+    p->topic = topic;
+    p->topic_name = topic->name();
+    p->partition = partition;
+    std::string name = p->topic_name + "/" + std::to_string(partition);
+
+    if (pipe2(p->pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        Logging::ERROR("Could not create the pipe of " + name + ": " + std::strerror(errno), m_name);
+        return false;
+    }
+    p->queue.reset(RdKafka::Queue::create(m_consumer));
+    p->queue->io_event_enable(p->pipe[1], "1", 1);
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = p.get();
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, p->pipe[0], &event) == -1) {
+        Logging::ERROR("Could not wait for " + name + ": " + std::strerror(errno), m_name);
+        close(p->pipe[0]);
+        close(p->pipe[1]);
+        return false;
+    }
+
+    RdKafka::ErrorCode resp = m_consumer->start(topic, partition, start_offset, p->queue.get());
+    if (resp != RdKafka::ERR_NO_ERROR) {
+        Logging::ERROR("Failed to start consuming " + name + ": " + RdKafka::err2str(resp), m_name);
+        p->queue.reset();
+        close(p->pipe[0]);
+        close(p->pipe[1]);
+        return false;
+    }
+
+    m_partitions.push_back(std::move(p));
+    return true;
+}
+
+bool EventLoopConsumer::start() {
+    if (m_epoll_fd == -1 || m_relieved_fd == -1) {
+        Logging::ERROR("Could not create the event loop", m_name);
+        return false;
+    }
+
+    m_t = std::make_unique<std::thread>(&EventLoopConsumer::run, this);
+    Logging::INFO("Started with " + std::to_string(m_partitions.size()) + " partitions", m_name);
+    return true;
+}
+
+void EventLoopConsumer::join() const {
+    if (m_t) {
+        ThreadGuard g(*m_t);
+    }
+}
+
+size_t EventLoopConsumer::errors() const { return m_errors; }
+
+/*
+Called by the decode workers once they are relieved
+*/
+void EventLoopConsumer::relieved() {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = write(m_relieved_fd, &one, sizeof(one));
+}
+
+/*
+Empties the pipe before the queue, so that messages that arrive in between signal it again
+*/
+void EventLoopConsumer::consume(Partition &partition) {
+    char buf[64];
+    while (read(partition.pipe[0], buf, sizeof(buf)) > 0) {
+    }
+
+    while (!partition.paused) {
+        size_t batch_size = m_tuner->batch_size();
+        MessageBatch batch;
+        batch.reserve(batch_size);
+
+        bool idle = false;
+        while (!idle && batch.size() < batch_size) {
+            RdKafka::Message *msg = partition.queue->consume(0);
+            switch (msg->err()) {
+                case RdKafka::ERR_NO_ERROR:
+                    // The decode worker owns the message from here on
+                    batch.push_back(msg);
+                    msg = nullptr;
+                    break;
+                case RdKafka::ERR__TIMED_OUT:
+                    idle = true;
+                    break;
+                case RdKafka::ERR__PARTITION_EOF:
+                    break;
+                default:
+                    ++m_errors;
+                    LOG_PER_SECOND(ERROR, m_name, 10, "Consume failed: {}", msg->errstr());
+            }
+            delete msg;
+        }
+
+        if (!batch.empty()) {
+            m_pool.dispatch(std::move(batch));
+        }
+        if (m_pool.congested(partition.topic_name, partition.partition)) {
+            pause(partition);
+        }
+        if (idle) {
+            break;
+        }
+    }
+}
+
+void EventLoopConsumer::pause(Partition &partition) {
+    std::vector<RdKafka::TopicPartition *> partitions = {
+        RdKafka::TopicPartition::create(partition.topic_name, partition.partition)};
+    m_consumer->pause(partitions);
+    RdKafka::TopicPartition::destroy(partitions);
+    partition.paused = true;
+    LOG_DEBUG(m_name, "Paused {}/{}", partition.topic_name, partition.partition);
+}
+
+/*
+A resumed partition may have messages left in its queue, which will not signal its pipe again, so it is consumed
+right away
+*/
+void EventLoopConsumer::resume_relieved() {
+    for (auto &partition : m_partitions) {
+        if (!partition->paused || m_pool.congested(partition->topic_name, partition->partition)) {
+            continue;
+        }
+        std::vector<RdKafka::TopicPartition *> partitions = {
+            RdKafka::TopicPartition::create(partition->topic_name, partition->partition)};
+        m_consumer->resume(partitions);
+        RdKafka::TopicPartition::destroy(partitions);
+        partition->paused = false;
+        LOG_DEBUG(m_name, "Resumed {}/{}", partition->topic_name, partition->partition);
+
+        consume(*partition);
+    }
+}
+
+void EventLoopConsumer::run() {
+    // Messages that arrived before the thread started have not been signalled
+    for (auto &partition : m_partitions) {
+        consume(*partition);
+    }
+
+    epoll_event events[MAX_EVENTS];
+    while (!m_sig_channel->m_shutdown_requested.load()) {
+        int n = epoll_wait(m_epoll_fd, events, MAX_EVENTS, POLL_INTERVAL_MS);
+        if (n == -1 && errno != EINTR) {
+            Logging::ERROR(std::string("Waiting for events failed: ") + std::strerror(errno), m_name);
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            void *source = events[i].data.ptr;
+            if (source == m_sig_channel.get()) {
+                continue;
+            }
+            if (source == this) {
+                uint64_t count;
+                [[maybe_unused]] ssize_t bytes_read = read(m_relieved_fd, &count, sizeof(count));
+                resume_relieved();
+                continue;
+            }
+            consume(*static_cast<Partition *>(source));
+        }
+
+        m_consumer->poll(0);
+    }
+
+    for (auto &partition : m_partitions) {
+        m_consumer->stop(partition->topic, partition->partition);
+    }
+    Logging::INFO("Shutting down", m_name);
+}
+
+EventLoopConsumer::~EventLoopConsumer() {
+    for (auto &partition : m_partitions) {
+        partition->queue.reset();
+        close(partition->pipe[0]);
+        close(partition->pipe[1]);
+    }
+    close(m_relieved_fd);
+    close(m_epoll_fd);
+}
+
+#endif
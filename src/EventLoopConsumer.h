@@ -0,0 +1,71 @@
+/**
+ * Consumes any number of partitions on a single thread that sleeps in epoll until there is something to do.
+ *
+ * Every partition is started on a queue of its own, and librdkafka writes to a pipe of the partition whenever its
+ * queue goes from empty to non-empty. The thread waits on those pipes, on the shutdown eventfd of the SignalChannel
+ * and on an eventfd the decode workers signal when they are relieved, so it wakes up as soon as messages arrive, a
+ * shutdown is requested or a paused partition can be resumed. Once awake, it hands everything that is queued for a
+ * partition to the DecodePool in batches of up to the BatchTuner's batch size; there is no linger, since whatever
+ * arrived while it slept is already waiting in the queue. Callbacks of the handle are served on the same thread.
+ *
+ * Partitions whose decode worker is congested are paused, and their queues are left alone until it is relieved.
+ **/
+#ifndef EVENT_LOOP_CONSUMER_H
+#define EVENT_LOOP_CONSUMER_H
+
+#ifdef __linux__
+
+#include <librdkafka/rdkafkacpp.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BatchTuner.h"
+#include "DecodePool.h"
+#include "SignalChannel.h"
+
+class EventLoopConsumer {
+   public:
+    EventLoopConsumer(RdKafka::Consumer *consumer, DecodePool &pool, std::shared_ptr<SignalChannel> sig_channel,
+                      std::shared_ptr<BatchTuner> tuner);
+    EventLoopConsumer(const EventLoopConsumer &) = delete;
+    void operator=(const EventLoopConsumer &) = delete;
+    bool add(RdKafka::Topic *topic, int32_t partition, int64_t start_offset);
+    bool start();
+    void join() const;
+    void relieved();
+    size_t errors() const;
+    ~EventLoopConsumer();
+
+   private:
+    const std::string m_name = "EventLoopConsumer";
+
+    struct Partition {
+        RdKafka::Topic *topic;
+        std::string topic_name;
+        int32_t partition;
+        std::unique_ptr<RdKafka::Queue> queue;
+        int pipe[2] = {-1, -1};
+        bool paused = false;
+    };
+
+    RdKafka::Consumer *m_consumer;
+    DecodePool &m_pool;
+    std::shared_ptr<SignalChannel> m_sig_channel;
+    std::shared_ptr<BatchTuner> m_tuner;
+    int m_epoll_fd;
+    int m_relieved_fd;
+    std::vector<std::unique_ptr<Partition>> m_partitions;
+    std::unique_ptr<std::thread> m_t;
+    size_t m_errors = 0;
+    void consume(Partition &partition);
+    void pause(Partition &partition);
+    void resume_relieved();
+    void run();
+};
+
+#endif
+
+#endif
@@ -0,0 +1,289 @@
+#include "GroupConsumer.h"
+
+#include <algorithm>
+
+#include "ThreadGuard.h"
+#include "logging/Logging.h"
+
+GroupConsumer::GroupConsumer(DecodePool &pool, std::shared_ptr<SignalChannel> sig_channel,
+                             std::shared_ptr<BatchTuner> tuner, int commit_interval_ms, int shutdown_timeout_ms)
+    : m_sig_channel(sig_channel),
+      m_pool(pool),
+      m_tuner(tuner),
+      m_commit_interval(std::max(0, commit_interval_ms)),
+      m_shutdown_timeout(std::max(0, shutdown_timeout_ms)) {}
+
+/*
+Offsets are stored and committed by the GroupConsumer itself, so automatic storing and committing are turned off
+whatever the configuration says
+*/
+bool GroupConsumer::create(RdKafka::Conf *conf, std::string &errstr) {
+    std::string group_id;
+    if (conf->get("group.id", group_id) != RdKafka::Conf::CONF_OK || group_id.empty()) {
+        errstr = "A group.id is required to consume as a group";
+        return false;
+    }
+
+    if (conf->set("rebalance_cb", this, errstr) != RdKafka::Conf::CONF_OK ||
+        conf->set("partition.assignment.strategy", "cooperative-sticky", errstr) != RdKafka::Conf::CONF_OK ||
+        conf->set("enable.auto.commit", "false", errstr) != RdKafka::Conf::CONF_OK ||
+        conf->set("enable.auto.offset.store", "false", errstr) != RdKafka::Conf::CONF_OK) {
+        return false;
+    }
+
+    m_consumer.reset(RdKafka::KafkaConsumer::create(conf, errstr));
+    if (!m_consumer) {
+        return false;
+    }
+    Logging::INFO("Created consumer " + m_consumer->name() + " in group '" + group_id + "'", m_name);
+    return true;
+}
+
+bool GroupConsumer::start(const std::vector<std::string> &topics) {
+    RdKafka::ErrorCode resp = m_consumer->subscribe(topics);
+    if (resp != RdKafka::ERR_NO_ERROR) {
+        Logging::ERROR("Failed to subscribe: " + RdKafka::err2str(resp), m_name);
+        return false;
+    }
+
+    m_t = std::make_unique<std::thread>(&GroupConsumer::run, this);
+    Logging::INFO("Started", m_name);
+    return true;
+}
+
+void GroupConsumer::join() const {
+    if (m_t) {
+        ThreadGuard g(*m_t);
+    }
+}
+
+size_t GroupConsumer::errors() const { return m_errors; }
+
+/*
+Called by the decode workers. Offsets of partitions that are no longer assigned are rejected by librdkafka, which
+is fine, since their offsets were committed when they were revoked.
+*/
+void GroupConsumer::store_offsets(const PartitionOffsets &offsets) {
+    std::vector<RdKafka::TopicPartition *> partitions;
+    for (const auto &[topic_partition, offset] : offsets) {
+        partitions.push_back(RdKafka::TopicPartition::create(topic_partition.first, topic_partition.second, offset));
+    }
+
+    RdKafka::ErrorCode resp = m_consumer->offsets_store(partitions);
+    if (resp != RdKafka::ERR_NO_ERROR && resp != RdKafka::ERR__STATE) {
+        LOG_PER_SECOND(WARN, m_name, 1, "Could not store offsets: {}", RdKafka::err2str(resp));
+    }
+    RdKafka::TopicPartition::destroy(partitions);
+}
+
+void GroupConsumer::commit() {
+    RdKafka::ErrorCode resp = m_consumer->commitAsync();
+    if (resp != RdKafka::ERR_NO_ERROR && resp != RdKafka::ERR__NO_OFFSET) {
+        LOG_PER_SECOND(WARN, m_name, 1, "Could not commit offsets: {}", RdKafka::err2str(resp));
+    }
+}
+
+void GroupConsumer::rebalance_cb(RdKafka::KafkaConsumer *consumer, RdKafka::ErrorCode err,
+                                 std::vector<RdKafka::TopicPartition *> &partitions) {
+    switch (err) {
+        case RdKafka::ERR__ASSIGN_PARTITIONS:
+            assign(partitions);
+            break;
+        case RdKafka::ERR__REVOKE_PARTITIONS:
+            revoke(partitions);
+            break;
+        default:
+            Logging::ERROR("Rebalancing failed: " + RdKafka::err2str(err), m_name);
+            revoke(partitions);
+    }
+}
+
+void GroupConsumer::assign(std::vector<RdKafka::TopicPartition *> &partitions) {
+    Logging::INFO("Assigned " + std::to_string(partitions.size()) + " partitions", m_name);
+    if (m_consumer->rebalance_protocol() == "COOPERATIVE") {
+        RdKafka::Error *error = m_consumer->incremental_assign(partitions);
+        if (error) {
+            Logging::ERROR("Could not assign partitions: " + error->str(), m_name);
+            delete error;
+        }
+        return;
+    }
+
+    RdKafka::ErrorCode resp = m_consumer->assign(partitions);
+    if (resp != RdKafka::ERR_NO_ERROR) {
+        Logging::ERROR("Could not assign partitions: " + RdKafka::err2str(resp), m_name);
+    }
+}
+
+/*
+Runs on the consuming thread, inside consume(). The batch being collected is dispatched first, then only the
+workers of the revoked partitions are drained before their final offsets are committed.
+*/
+void GroupConsumer::revoke(std::vector<RdKafka::TopicPartition *> &partitions) {
+    dispatch();
+
+    std::vector<TopicPartition> revoked;
+    for (const RdKafka::TopicPartition *partition : partitions) {
+        revoked.emplace_back(partition->topic(), partition->partition());
+    }
+    if (!m_pool.drain(revoked, m_drain_deadline)) {
+        Logging::WARN("Gave up draining the revoked partitions, only what has been written so far is committed",
+                      m_name);
+    }
+
+    // A partition that is assigned again later starts out unpaused
+    m_consumer->resume(partitions);
+    for (const TopicPartition &partition : revoked) {
+        m_paused.erase(partition);
+    }
+
+    RdKafka::ErrorCode resp = m_consumer->commitSync();
+    if (resp != RdKafka::ERR_NO_ERROR && resp != RdKafka::ERR__NO_OFFSET) {
+        Logging::ERROR("Could not commit offsets of revoked partitions: " + RdKafka::err2str(resp), m_name);
+    }
+    Logging::INFO("Revoked " + std::to_string(partitions.size()) + " partitions", m_name);
+
+    if (m_consumer->rebalance_protocol() == "COOPERATIVE") {
+        RdKafka::Error *error = m_consumer->incremental_unassign(partitions);
+        if (error) {
+            Logging::ERROR("Could not unassign partitions: " + error->str(), m_name);
+            delete error;
+        }
+        return;
+    }
+    m_consumer->unassign();
+}
+
+/*
+Blocks for up to one second for the first message. Once a message has arrived, keeps collecting until the batch
+is full or the linger time has passed. Returns false if nothing was consumed.
+*/
+bool GroupConsumer::consume_batch() {
+    // Paused partitions are checked for being resumed after every batch, so wait less long while there are any
+    int timeout_ms = m_paused.empty() ? 1000 : 100;
+    std::chrono::steady_clock::time_point deadline;
+    size_t batch_size = m_tuner->batch_size();
+    std::chrono::milliseconds linger = m_tuner->linger();
+
+    while (m_batch.size() < batch_size) {
+        RdKafka::Message *msg = m_consumer->consume(timeout_ms);
+        switch (msg->err()) {
+            case RdKafka::ERR_NO_ERROR:
+                if (m_batch.empty()) {
+                    deadline = std::chrono::steady_clock::now() + linger;
+                }
+                // The decode worker owns the message from here on
+                m_batch.push_back(msg);
+                msg = nullptr;
+                break;
+            case RdKafka::ERR__TIMED_OUT:
+            case RdKafka::ERR__PARTITION_EOF:
+                break;
+            default:
+                ++m_errors;
+                LOG_PER_SECOND(ERROR, m_name, 10, "Consume failed: {}", msg->errstr());
+        }
+        bool idle = msg != nullptr;
+        delete msg;
+
+        if (m_batch.empty() || (idle && linger.count() == 0)) {
+            break;
+        }
+
+        auto remaining =
+            std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() < 0) {
+            break;
+        }
+        timeout_ms = static_cast<int>(remaining.count());
+    }
+
+    return !m_batch.empty();
+}
+
+/*
+Hands the batch to the DecodePool and pauses the partitions in it whose worker is now congested
+*/
+void GroupConsumer::dispatch() {
+    if (m_batch.empty()) {
+        return;
+    }
+
+    std::set<TopicPartition> partitions;
+    const RdKafka::Message *previous = nullptr;
+    for (const RdKafka::Message *message : m_batch) {
+        if (!previous || message->topic() != previous->topic() || message->partition() != previous->partition()) {
+            partitions.emplace(message->topic_name(), message->partition());
+        }
+        previous = message;
+    }
+
+    m_pool.dispatch(std::move(m_batch));
+    m_batch = MessageBatch();
+    pause_congested(partitions);
+}
+
+void GroupConsumer::pause_congested(const std::set<TopicPartition> &partitions) {
+    std::vector<RdKafka::TopicPartition *> paused;
+    for (const TopicPartition &partition : partitions) {
+        if (!m_paused.count(partition) && m_pool.congested(partition.first, partition.second)) {
+            m_paused.insert(partition);
+            paused.push_back(RdKafka::TopicPartition::create(partition.first, partition.second));
+        }
+    }
+    if (paused.empty()) {
+        return;
+    }
+
+    RdKafka::ErrorCode resp = m_consumer->pause(paused);
+    if (resp != RdKafka::ERR_NO_ERROR) {
+        LOG_PER_SECOND(WARN, m_name, 1, "Could not pause partitions: {}", RdKafka::err2str(resp));
+    }
+    LOG_DEBUG(m_name, "Paused {} partitions, {} paused in total", paused.size(), m_paused.size());
+    RdKafka::TopicPartition::destroy(paused);
+}
+
+void GroupConsumer::resume_relieved() {
+    std::vector<RdKafka::TopicPartition *> resumed;
+    for (auto it = m_paused.begin(); it != m_paused.end();) {
+        if (m_pool.congested(it->first, it->second)) {
+            ++it;
+            continue;
+        }
+        resumed.push_back(RdKafka::TopicPartition::create(it->first, it->second));
+        it = m_paused.erase(it);
+    }
+    if (resumed.empty()) {
+        return;
+    }
+
+    RdKafka::ErrorCode resp = m_consumer->resume(resumed);
+    if (resp != RdKafka::ERR_NO_ERROR) {
+        LOG_PER_SECOND(WARN, m_name, 1, "Could not resume partitions: {}", RdKafka::err2str(resp));
+    }
+    LOG_DEBUG(m_name, "Resumed {} partitions, {} paused in total", resumed.size(), m_paused.size());
+    RdKafka::TopicPartition::destroy(resumed);
+}
+
+void GroupConsumer::run() {
+    auto last_commit = std::chrono::steady_clock::now();
+    while (!m_sig_channel->m_shutdown_requested.load()) {
+        m_batch.reserve(m_tuner->batch_size());
+        if (consume_batch()) {
+            dispatch();
+        }
+        resume_relieved();
+
+        if (std::chrono::steady_clock::now() - last_commit >= m_commit_interval) {
+            commit();
+            last_commit = std::chrono::steady_clock::now();
+        }
+    }
+
+    // Leaving the group revokes every partition, which drains the decode workers and commits the final offsets
+    m_drain_deadline = std::chrono::steady_clock::now() + m_shutdown_timeout;
+    m_consumer->close();
+    Logging::INFO("Shutting down", m_name);
+}
+
+GroupConsumer::~GroupConsumer() {}
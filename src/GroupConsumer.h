@@ -0,0 +1,69 @@
+/**
+ * Consumes the topics of the type_map as a member of a consumer group, on a dedicated thread.
+ *
+ * Partitions are spread over the members of the group with the cooperative-sticky assignor, so a rebalance only
+ * moves the partitions that change owner and the others keep being consumed. Consumed messages are batched like
+ * in PartitionConsumer and handed off to the DecodePool. Partitions whose decode worker is congested are paused,
+ * and resumed once it has caught up, while the other partitions keep being consumed.
+ *
+ * Offsets are never committed automatically. The DecodePool reports the offsets of messages its sinks have written
+ * durably, which are stored and committed asynchronously every commit_interval_ms. Before a partition is given up,
+ * the work dispatched for it is drained and its offsets are committed synchronously, so the next owner starts
+ * right behind the last message written. On shutdown the group is left within shutdown_timeout_ms; what the decode
+ * workers have not written by then is not committed.
+ **/
+#ifndef GROUP_CONSUMER_H
+#define GROUP_CONSUMER_H
+
+#include <librdkafka/rdkafkacpp.h>
+
+#include <chrono>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BatchTuner.h"
+#include "DecodePool.h"
+#include "SignalChannel.h"
+
+class GroupConsumer : public RdKafka::RebalanceCb {
+   public:
+    GroupConsumer(DecodePool &pool, std::shared_ptr<SignalChannel> sig_channel, std::shared_ptr<BatchTuner> tuner,
+                  int commit_interval_ms = 5000, int shutdown_timeout_ms = 30000);
+    GroupConsumer(const GroupConsumer &) = delete;
+    void operator=(const GroupConsumer &) = delete;
+    bool create(RdKafka::Conf *conf, std::string &errstr);
+    bool start(const std::vector<std::string> &topics);
+    void join() const;
+    void store_offsets(const PartitionOffsets &offsets);
+    void rebalance_cb(RdKafka::KafkaConsumer *consumer, RdKafka::ErrorCode err,
+                      std::vector<RdKafka::TopicPartition *> &partitions) override;
+    size_t errors() const;
+    ~GroupConsumer();
+
+   private:
+    const std::string m_name = "GroupConsumer";
+    std::unique_ptr<RdKafka::KafkaConsumer> m_consumer;
+    std::shared_ptr<SignalChannel> m_sig_channel;
+    DecodePool &m_pool;
+    std::shared_ptr<BatchTuner> m_tuner;
+    std::chrono::milliseconds m_commit_interval;
+    std::chrono::milliseconds m_shutdown_timeout;
+    std::chrono::steady_clock::time_point m_drain_deadline = std::chrono::steady_clock::time_point::max();
+    MessageBatch m_batch;
+    std::set<TopicPartition> m_paused;
+    std::unique_ptr<std::thread> m_t;
+    size_t m_errors = 0;
+    bool consume_batch();
+    void dispatch();
+    void pause_congested(const std::set<TopicPartition> &partitions);
+    void resume_relieved();
+    void commit();
+    void assign(std::vector<RdKafka::TopicPartition *> &partitions);
+    void revoke(std::vector<RdKafka::TopicPartition *> &partitions);
+    void run();
+};
+
+#endif
@@ -1,14 +1,64 @@
 #include "KafkaConsumerCallback.h"
 
-#include <cpprest/http_client.h>  // web::json::value
+#include <mutex>
+#include <set>
 
-#include <ctime>
-#include <iomanip>
-#include <sstream>
-
-#include "Database.h"
 #include "logging/Logging.h"
-KafkaConsumerCallback::KafkaConsumerCallback() { m_schema = SchemaRegistry::instance().fetch_value_schema("spo"); }
+
+/*
+Every decode worker has a callback of its own per topic, so only the first one to find it tells
+*/
+static void warn_passthrough_unavailable(const std::string &topic) {
+    static std::mutex mutex;
+    static std::set<std::string> warned;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (warned.insert(topic).second) {
+        Logging::WARN("Topic '" + topic + "' is decoded in passthrough mode, but a configured sink reads JSON, so " +
+                          "its records are transcoded instead",
+                      "KafkaConsumerCallback");
+    }
+}
+
+KafkaConsumerCallback::KafkaConsumerCallback(const std::string &topic, DecodeMode mode, Sink *sink)
+    : m_mode(mode),
+      m_passthrough(mode == DecodeMode::PASSTHROUGH && sink && !sink->needs_json()),
+      m_sink(sink),
+      m_out_stream(m_out) {
+    m_out.reserve(OUTPUT_RESERVE);
+    if (mode == DecodeMode::PASSTHROUGH && !m_passthrough) {
+        warn_passthrough_unavailable(topic);
+    }
+
+    // The latest schema of the topic's value subject is used as reader schema. Without one, records are read with
+    // the schema they were written with.
+    Serdes::Schema *schema = m_passthrough ? nullptr : SchemaRegistry::instance().fetch_value_schema(topic);
+    if (schema) {
+        m_reader_id = schema->id();
+        delete schema;
+    }
+
+    // Compile the plan for the current schema up front rather than on the first message
+    if (m_mode == DecodeMode::PLAN && m_reader_id >= 0) {
+        std::string errstr;
+        plan_for(m_reader_id, errstr);
+    }
+}
+
+DecodeMode KafkaConsumerCallback::parse_decode_mode(const std::string &mode) {
+    if (mode == "generic") {
+        return DecodeMode::GENERIC;
+    }
+    if (mode == "plan") {
+        return DecodeMode::PLAN;
+    }
+    if (mode == "passthrough") {
+        return DecodeMode::PASSTHROUGH;
+    }
+    if (!mode.empty() && mode != "transcode") {
+        Logging::WARN("Unknown decode mode '" + mode + "', using 'transcode'", "KafkaConsumerCallback");
+    }
+    return DecodeMode::TRANSCODE;
+}
 
 bool KafkaConsumerCallback::consume_message(RdKafka::Message *message) {
     bool exit_eof = false;
@@ -26,92 +76,237 @@ bool KafkaConsumerCallback::consume_message(RdKafka::Message *message) {
             break;
         case RdKafka::ERR__UNKNOWN_TOPIC:
         case RdKafka::ERR__UNKNOWN_PARTITION:
-            Logging::ERROR("Consume failed: " + message->errstr(), m_name);
+            LOG_PER_SECOND(ERROR, m_name, 10, "Consume failed: {}", message->errstr());
             return false;
             break;
         default:
             /* Errors */
-            Logging::ERROR("Consume failed: " + message->errstr(), m_name);
+            LOG_PER_SECOND(ERROR, m_name, 10, "Consume failed: {}", message->errstr());
             return false;
     }
     return true;
 }
 
-void KafkaConsumerCallback::consume_cb(RdKafka::Message &msg, void *opaque) { consume_message(&msg); }
+/*
+Without a sink, decoded records of a batch are collected in m_out and written to stdout with a single call once
+the whole batch has been processed.
+*/
+size_t KafkaConsumerCallback::consume_batch(std::span<RdKafka::Message *const> messages) {
+    size_t failed = 0;
+    for (RdKafka::Message *message : messages) {
+        if (!consume_message(message)) {
+            ++failed;
+        }
+    }
+    flush_output();
+    return failed;
+}
 
-int KafkaConsumerCallback::avro2json(Serdes::Schema *schema, const avro::GenericDatum *datum, std::string &str,
-                                     std::string &errstr) {
-    avro::ValidSchema *avro_schema = schema->object();
+void KafkaConsumerCallback::flush_output() {
+    if (!m_out.empty()) {
+        std::cout << m_out << std::flush;
+        m_out.clear();
+    }
+}
 
-    /* JSON encoder */
-    avro::EncoderPtr json_encoder = avro::jsonEncoder(*avro_schema);
+void KafkaConsumerCallback::consume_cb(RdKafka::Message &msg, void *opaque) {
+    consume_message(&msg);
+    flush_output();
+}
 
-    /* JSON output stream */
-    std::ostringstream oss;
-    auto json_os = avro::ostreamOutputStream(oss);
+/*
+Schemas are looked up in the registry once per callback, after which the hot path does not touch the registry's
+lock again
+*/
+const avro::ValidSchema *KafkaConsumerCallback::schema_for(int32_t id, std::string &errstr) {
+    auto found = m_schemas.find(id);
+    if (found == m_schemas.end()) {
+        std::shared_ptr<const avro::ValidSchema> schema = SchemaRegistry::instance().schema_for_id(id, errstr);
+        if (!schema) {
+            return nullptr;
+        }
+        found = m_schemas.emplace(id, std::move(schema)).first;
+    }
+    return found->second.get();
+}
 
+/*
+Encodes the datum to JSON into m_out, re-initialising the cached encoder of the schema
+*/
+int KafkaConsumerCallback::avro2json(const avro::EncoderPtr &json_encoder, const avro::GenericDatum &datum,
+                                     std::string &errstr) {
+    size_t mark = m_out.size();
     try {
         /* Encode Avro datum to JSON */
-        json_encoder->init(*json_os.get());
-        avro::encode(*json_encoder, *datum);
+        json_encoder->init(m_out_stream);
+        avro::encode(*json_encoder, datum);
         json_encoder->flush();
 
     } catch (const avro::Exception &e) {
+        m_out.resize(mark);
         errstr = std::string("Binary to JSON transformation failed: ") + e.what();
-        Logging::ERROR(errstr, m_name);
+        LOG_PER_SECOND(ERROR, m_name, 10, "{}", errstr);
         return -1;
     }
 
-    str = oss.str();
     return 0;
 }
 
+/*
+Streams the payload into m_out using the writer schema, without building a datum or a JSON encoder
+*/
+bool KafkaConsumerCallback::transcode(RdKafka::Message *message, int32_t writer_id, std::string &errstr) {
+    const avro::ValidSchema *schema = schema_for(writer_id, errstr);
+    if (!schema) {
+        return false;
+    }
+
+    const uint8_t *payload = static_cast<const uint8_t *>(message->payload()) + SchemaRegistry::CP1_FRAMING_SIZE;
+    ssize_t bytes_read =
+        m_transcoder.transcode(*schema, payload, message->len() - SchemaRegistry::CP1_FRAMING_SIZE, m_out, errstr);
+    if (bytes_read == -1) {
+        return false;
+    }
+    LOG_EVERY_N(INFO, m_name, 1000, "deserialize() read : {} bytes", bytes_read);
+    return true;
+}
+
+/*
+Decodes the payload into a datum, resolved against the reader schema if it was written with another one, and
+encodes the datum to JSON into m_out
+*/
+bool KafkaConsumerCallback::decode_generic(RdKafka::Message *message, int32_t writer_id, std::string &errstr) {
+    int32_t reader_id = m_reader_id < 0 ? writer_id : m_reader_id;
+
+    const avro::ValidSchema *schema = schema_for(reader_id, errstr);
+    avro::DecoderPtr decoder = schema ? SchemaRegistry::instance().decoder_for(writer_id, reader_id, errstr) : nullptr;
+    if (!decoder) {
+        return false;
+    }
+
+    // The datum and JSON encoder of a schema are created once and reused for every message
+    auto state = m_generic_states.find(reader_id);
+    if (state == m_generic_states.end()) {
+        GenericState generic_state{avro::GenericDatum(*schema), avro::jsonEncoder(*schema)};
+        state = m_generic_states.emplace(reader_id, std::move(generic_state)).first;
+    }
+    avro::GenericDatum &datum = state->second.datum;
+
+    const uint8_t *payload = static_cast<const uint8_t *>(message->payload()) + SchemaRegistry::CP1_FRAMING_SIZE;
+    m_in.reset(payload, message->len() - SchemaRegistry::CP1_FRAMING_SIZE);
+    try {
+        decoder->init(m_in);
+        avro::GenericReader::read(*decoder, datum, writer_id != reader_id);
+        decoder->drain();
+    } catch (const avro::Exception &e) {
+        errstr = std::string("Avro deserialization failed: ") + e.what();
+        return false;
+    }
+    LOG_EVERY_N(INFO, m_name, 1000, "deserialize() read : {} bytes", m_in.byteCount());
+
+    return avro2json(state->second.json_encoder, datum, errstr) == 0;
+}
+
+/*
+Plans are compiled once per writer schema. A schema that cannot be compiled is remembered as such, so that it is
+not tried again for every message.
+*/
+const DecodePlan *KafkaConsumerCallback::plan_for(int32_t writer_id, std::string &errstr) {
+    auto found = m_plans.find(writer_id);
+    if (found != m_plans.end()) {
+        return found->second.get();
+    }
+
+    const avro::ValidSchema *schema = schema_for(writer_id, errstr);
+    if (!schema) {
+        return nullptr;
+    }
+
+    std::unique_ptr<DecodePlan> plan = DecodePlan::compile(*schema, errstr);
+    if (plan) {
+        Logging::INFO("Compiled decode plan with " + std::to_string(plan->size()) + " fields for schema id " +
+                          std::to_string(writer_id),
+                      m_name);
+    } else {
+        Logging::WARN("Schema id " + std::to_string(writer_id) + " falls back to transcoding: " + errstr, m_name);
+    }
+    return m_plans.emplace(writer_id, std::move(plan)).first->second.get();
+}
+
+bool KafkaConsumerCallback::decode_plan(RdKafka::Message *message, int32_t writer_id, std::string &errstr) {
+    const DecodePlan *plan = plan_for(writer_id, errstr);
+    if (!plan) {
+        return transcode(message, writer_id, errstr);
+    }
+
+    const uint8_t *payload = static_cast<const uint8_t *>(message->payload()) + SchemaRegistry::CP1_FRAMING_SIZE;
+    ssize_t bytes_read = plan->decode(payload, message->len() - SchemaRegistry::CP1_FRAMING_SIZE, m_record, errstr);
+    if (bytes_read == -1) {
+        return false;
+    }
+    LOG_EVERY_N(INFO, m_name, 1000, "deserialize() read : {} bytes", bytes_read);
+
+    plan->to_json(m_record, m_out);
+    return true;
+}
+
 size_t KafkaConsumerCallback::deserialize(RdKafka::Message *message) {
     std::string errstr;
 
-    // https://github.com/confluentinc/libserdes/blob/master/examples/kafka-serdes-avro-console-consumer.cpp
+    /*
+    The writer schema is looked up by the schema id in the CP1 framing, so records written with another schema
+    version are never decoded with the wrong one.
+    */
+    int32_t writer_id = SchemaRegistry::schema_id(message->payload(), message->len());
+    if (writer_id == -1) {
+        LOG_PER_SECOND(ERROR, m_name, 10, "Message at offset {} has no CP1 framing", message->offset());
+        return 0;
+    }
 
-    std::string out;
-    avro::GenericDatum *d = NULL;
+    // The sink gets a record that refers to the consumed payload, which stays alive until the batch has been flushed
+    if (m_passthrough) {
+        SinkRecord record{message, writer_id, std::string_view(), nullptr};
+        m_sink->write(record);
+        return message->len();
+    }
 
-    ssize_t bytes_read =
-        SchemaRegistry::instance().m_serdes->deserialize(&m_schema, &d, message->payload(), message->len(), errstr);
-    if (bytes_read == -1) {
-        Logging::ERROR("Serdes::Avro::deserialize() failed to deserialize: " + errstr, m_name);
+    size_t mark = m_out.size();
+    bool decoded = false;
+    m_record.plan = nullptr;
+    switch (m_mode) {
+        case DecodeMode::GENERIC:
+            decoded = decode_generic(message, writer_id, errstr);
+            break;
+        case DecodeMode::TRANSCODE:
+        case DecodeMode::PASSTHROUGH:
+            decoded = transcode(message, writer_id, errstr);
+            break;
+        case DecodeMode::PLAN:
+            decoded = decode_plan(message, writer_id, errstr);
+            break;
+    }
+    if (!decoded) {
+        m_out.resize(mark);
+        LOG_PER_SECOND(ERROR, m_name, 10, "deserialize() failed to deserialize: {}", errstr);
+        return 0;
+    }
+
+    size_t size = m_out.size() - mark;
+    if (size == 0) {
+        return 0;
+    }
+
+    // m_out only serves as scratch space for the record when it goes to a sink
+    if (m_sink) {
+        SinkRecord record{message, writer_id, std::string_view(m_out.data() + mark, size),
+                          m_record.plan ? &m_record : nullptr};
+        m_sink->write(record);
+        m_out.resize(mark);
     } else {
-        Logging::INFO("Serdes::Avro::deserialize() read : " + std::to_string(bytes_read) + " bytes", m_name);
-    }
-    if (avro2json(m_schema, d, out, errstr) == -1) {
-        Logging::ERROR("KafkaConsumerCallback::avro2json() failed to deserialize: " + errstr, m_name);
-    }
-    if (!out.empty()) {
-        std::cout << out << std::endl;
-        // web::json::value json_value = web::json::value::parse(out);
-        // std::string subject = json_value["subject"].as_string();
-        // std::string predicate = json_value["predicate"].as_string();
-        // std::string object = json_value["object"].as_string();
-
-        // auto t = std::time(nullptr);
-        // auto tm = *std::localtime(&t);
-
-        // std::ostringstream oss;
-        // oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
-        // std::string created_at = oss.str();
-
-        // if (Database::instance().insert_object(subject, "MyObjectType", created_at) &&
-        //     Database::instance().insert_object(object, "MyObjectType", created_at)) {
-        //     int source_id = Database::instance().get_object_id(subject);
-        //     int target_id = Database::instance().get_object_id(object);
-        //     if (!Database::instance().insert_relationship(source_id, target_id, predicate)) {
-        //         Logging::ERROR("Could not persist predicate", m_name);
-        //     }
-        // } else {
-        //     Logging::ERROR("Could not persist either subject or object", m_name);
-        // }
-    }
-
-    delete d;
-    return out.length();
+        m_out.push_back('\n');
+    }
+
+    return size;
 }
 
-KafkaConsumerCallback::~KafkaConsumerCallback() { delete m_schema; }
\ No newline at end of file
+KafkaConsumerCallback::~KafkaConsumerCallback() {}
\ No newline at end of file
@@ -5,19 +5,71 @@
 
 #include <cstring>
 #include <iostream>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "SchemaRegistry.h"
+#include "decode/AvroJsonTranscoder.h"
+#include "decode/AvroStreams.h"
+#include "decode/DecodePlan.h"
+#include "sinks/Sink.h"
+
+using MessageBatch = std::vector<RdKafka::Message *>;
+
+/*
+How payloads are turned into JSON. GENERIC decodes into an avro::GenericDatum, resolved against the reader schema,
+and encodes that with avro::jsonEncoder. TRANSCODE streams the payload straight into JSON using the writer schema.
+PLAN decodes flat records with a DecodePlan compiled per writer schema and falls back to TRANSCODE for schemas that
+cannot be compiled. PASSTHROUGH only reads the schema id from the CP1 framing and hands the undecoded payload to the
+sink, unless the sink needs JSON, in which case records are transcoded.
+*/
+enum class DecodeMode { GENERIC, TRANSCODE, PLAN, PASSTHROUGH };
+
 class KafkaConsumerCallback : public RdKafka::ConsumeCb {
    public:
-    KafkaConsumerCallback();
+    KafkaConsumerCallback(const std::string &topic, DecodeMode mode = DecodeMode::TRANSCODE, Sink *sink = nullptr);
+    KafkaConsumerCallback(const KafkaConsumerCallback &) = delete;
+    void operator=(const KafkaConsumerCallback &) = delete;
     void consume_cb(RdKafka::Message &msg, void *opaque) override;
     bool consume_message(RdKafka::Message *message);
+    size_t consume_batch(std::span<RdKafka::Message *const> messages);
     ~KafkaConsumerCallback();
 
+    static DecodeMode parse_decode_mode(const std::string &mode);
+
    private:
     const std::string m_name = "KafkaConsumerCallback";
-    Serdes::Schema *m_schema;
-    int avro2json(Serdes::Schema *schema, const avro::GenericDatum *datum, std::string &str, std::string &errstr);
+    static constexpr size_t OUTPUT_RESERVE = 1 << 16;
+
+    /*
+    Datum and JSON encoder of the generic path, kept per reader schema and reused for every message
+    */
+    struct GenericState {
+        avro::GenericDatum datum;
+        avro::EncoderPtr json_encoder;
+    };
+
+    const DecodeMode m_mode;
+    const bool m_passthrough;
+    int32_t m_reader_id = -1;
+    std::unordered_map<int32_t, std::shared_ptr<const avro::ValidSchema>> m_schemas;
+    std::unordered_map<int32_t, GenericState> m_generic_states;
+    BufferInputStream m_in;
+    AvroJsonTranscoder m_transcoder;
+    std::unordered_map<int32_t, std::unique_ptr<DecodePlan>> m_plans;
+    FlatRecord m_record;
+    Sink *m_sink;
+    std::string m_out;
+    StringOutputStream m_out_stream;
+    void flush_output();
+    const avro::ValidSchema *schema_for(int32_t id, std::string &errstr);
+    int avro2json(const avro::EncoderPtr &json_encoder, const avro::GenericDatum &datum, std::string &errstr);
+    bool transcode(RdKafka::Message *message, int32_t writer_id, std::string &errstr);
+    bool decode_generic(RdKafka::Message *message, int32_t writer_id, std::string &errstr);
+    const DecodePlan *plan_for(int32_t writer_id, std::string &errstr);
+    bool decode_plan(RdKafka::Message *message, int32_t writer_id, std::string &errstr);
     size_t deserialize(RdKafka::Message *message);
 };
 
@@ -22,17 +22,10 @@ void KafkaPoller::join() const
 
 void KafkaPoller::run()
 {
+    // poll() sleeps until a delivery report is due or the timeout expires, so reports are served as they arrive
     while (!m_sig_channel->m_shutdown_requested.load())
     {
-        {
-            std::unique_lock shutdown_lock(m_sig_channel->m_cv_mutex);
-            m_sig_channel->m_cv.wait_for(shutdown_lock, std::chrono::milliseconds(10), [this]()
-                                         { bool should_shutdown = m_sig_channel->m_shutdown_requested.load();
-                                     return should_shutdown; });
-        }
-
-        m_kafka_producer->poll(0);
-        std::this_thread::sleep_for(std::chrono::milliseconds(10000));
+        m_kafka_producer->poll(100);
     }
 
     Logging::INFO("Shutting down", name);
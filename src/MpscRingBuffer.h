@@ -0,0 +1,198 @@
+#ifndef MPSC_RING_BUFFER_H
+#define MPSC_RING_BUFFER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// A bounded lock-free queue for many producers and a single consumer.
+//
+// Slots are preallocated and carry a sequence number that tells producers and the consumer whose turn it is
+// (D. Vyukov's bounded queue), so enqueueing is a single CAS and never takes a lock. Dequeueing claims slots with
+// a CAS as well, which lets a producer evict the oldest element under the OVERWRITE policy. The consumer only
+// sleeps on a condition variable when the queue is empty, and producers only touch that condition variable while
+// the consumer is actually asleep.
+template <typename T>
+class MpscRingBuffer {
+   public:
+    // What enqueue() does when the queue is full
+    enum class Policy : uint8_t {
+        DROP,       // Discard the new element
+        OVERWRITE,  // Discard the oldest element
+        BLOCK       // Wait until the consumer has made room
+    };
+
+    // The capacity is rounded up to a power of two
+    explicit MpscRingBuffer(size_t capacity, Policy policy = Policy::DROP) : m_policy(policy) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+        m_slots = std::make_unique<Slot[]>(size);
+        for (size_t i = 0; i < size; ++i) {
+            m_slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRingBuffer(const MpscRingBuffer &) = delete;
+    void operator=(const MpscRingBuffer &) = delete;
+
+    ~MpscRingBuffer(void) {}
+
+    // Add an element to the queue. Returns false if it was dropped because the queue was full.
+    bool enqueue(T t) {
+        while (!try_enqueue(t)) {
+            switch (m_policy.load(std::memory_order_relaxed)) {
+                case Policy::DROP:
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                case Policy::OVERWRITE: {
+                    T oldest;
+                    if (try_dequeue(oldest)) {
+                        m_overwritten.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    break;
+                }
+                case Policy::BLOCK:
+                    notify_consumer();
+                    std::this_thread::yield();
+                    break;
+            }
+        }
+        notify_consumer();
+        return true;
+    }
+
+    // Get the "front"-element without waiting. Returns false if the queue is empty.
+    bool try_dequeue(T &val) {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;) {
+            slot = &m_slots[pos & m_mask];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (dif == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        val = std::move(slot->value);
+        slot->seq.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Get the "front"-element.
+    // If the queue is empty, wait till a element is avaiable.
+    T dequeue(void) {
+        T val;
+        while (!dequeue_with_timeout(1000, val)) {
+        }
+        return val;
+    }
+
+    // Wait up to ms milliseconds for an element. Returns false if none arrived.
+    bool dequeue_with_timeout(const int ms, T &val) {
+        if (try_dequeue(val)) {
+            return true;
+        }
+
+        std::unique_lock<std::mutex> lock(m_wait_mutex);
+        m_consumer_waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool found = m_wait_cv.wait_for(lock, std::chrono::milliseconds(ms), [this, &val]() {
+            bool stop_waiting = try_dequeue(val);
+            return stop_waiting;
+        });
+        m_consumer_waiting.store(false, std::memory_order_relaxed);
+        return found;
+    }
+
+    // Move up to max available elements to the back of out without waiting. Returns how many were moved.
+    template <typename Container>
+    size_t drain(Container &out, size_t max) {
+        size_t n = 0;
+        T val;
+        while (n < max && try_dequeue(val)) {
+            out.push_back(std::move(val));
+            ++n;
+        }
+        return n;
+    }
+
+    // Approximate while producers are active
+    size_t size() const {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+    void set_policy(Policy policy) { m_policy.store(policy, std::memory_order_relaxed); }
+
+    // Elements discarded by the DROP policy
+    size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    // Elements evicted by the OVERWRITE policy
+    size_t overwritten() const { return m_overwritten.load(std::memory_order_relaxed); }
+
+   private:
+    struct Slot {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask;
+    std::atomic<Policy> m_policy;
+    alignas(64) std::atomic<size_t> m_head = 0;  // Next position to enqueue at
+    alignas(64) std::atomic<size_t> m_tail = 0;  // Next position to dequeue from
+    alignas(64) std::atomic<bool> m_consumer_waiting = false;
+    std::atomic<size_t> m_dropped = 0;
+    std::atomic<size_t> m_overwritten = 0;
+    std::mutex m_wait_mutex;
+    std::condition_variable m_wait_cv;
+
+    bool try_enqueue(T &t) {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;) {
+            slot = &m_slots[pos & m_mask];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (dif == 0) {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = std::move(t);
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Wake the consumer, taking the lock only if it is asleep
+    void notify_consumer() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_consumer_waiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(m_wait_mutex);
+            m_wait_cv.notify_one();
+        }
+    }
+};
+#endif
@@ -0,0 +1,56 @@
+#include "ObjectIdCache.h"
+
+#include <iterator>
+
+ObjectIdCache::ObjectIdCache(size_t capacity) : m_capacity(capacity) { m_index.reserve(capacity); }
+
+bool ObjectIdCache::get(const std::string &object_name, int &id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_index.find(object_name);
+    if (found == m_index.end()) {
+        ++m_misses;
+        return false;
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, found->second);
+    id = found->second->second;
+    ++m_hits;
+    return true;
+}
+
+void ObjectIdCache::put(const std::string &object_name, int id) {
+    if (m_capacity == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_index.find(object_name);
+    if (found != m_index.end()) {
+        found->second->second = id;
+        m_entries.splice(m_entries.begin(), m_entries, found->second);
+        return;
+    }
+
+    // Reuse the least recently used entry once the cache is full
+    if (m_index.size() == m_capacity) {
+        auto last = std::prev(m_entries.end());
+        m_index.erase(last->first);
+        last->first = object_name;
+        last->second = id;
+        m_entries.splice(m_entries.begin(), m_entries, last);
+    } else {
+        m_entries.emplace_front(object_name, id);
+    }
+    m_index.emplace(object_name, m_entries.begin());
+}
+
+size_t ObjectIdCache::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_index.size();
+}
+
+size_t ObjectIdCache::capacity() const { return m_capacity; }
+
+size_t ObjectIdCache::hits() const { return m_hits.load(); }
+
+size_t ObjectIdCache::misses() const { return m_misses.load(); }
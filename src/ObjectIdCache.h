@@ -0,0 +1,42 @@
+/**
+ * Bounded, least recently used map from object name to object id.
+ *
+ * The same entity names repeat constantly in the SPO stream, so Database keeps the ids it has seen here instead of
+ * selecting them again for every subject and object. The cache is filled from the ids returned by inserts and
+ * warmed with the newest objects at startup. Hits and misses are counted so the capacity can be sized.
+ * All operations are thread safe.
+ **/
+#ifndef OBJECT_ID_CACHE_H
+#define OBJECT_ID_CACHE_H
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+class ObjectIdCache {
+   public:
+    ObjectIdCache(size_t capacity);
+    ObjectIdCache(const ObjectIdCache &) = delete;
+    void operator=(const ObjectIdCache &) = delete;
+    bool get(const std::string &object_name, int &id);
+    void put(const std::string &object_name, int id);
+    size_t size() const;
+    size_t capacity() const;
+    size_t hits() const;
+    size_t misses() const;
+
+   private:
+    using Entry = std::pair<std::string, int>;
+
+    const size_t m_capacity;
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries;  // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+    std::atomic<size_t> m_hits = 0;
+    std::atomic<size_t> m_misses = 0;
+};
+
+#endif
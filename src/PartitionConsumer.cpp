@@ -0,0 +1,151 @@
+#include "PartitionConsumer.h"
+
+#include <algorithm>
+
+#include "ThreadGuard.h"
+#include "logging/Logging.h"
+
+PartitionConsumer::PartitionConsumer(RdKafka::Consumer *consumer, RdKafka::Topic *topic, int32_t partition,
+                                     DecodePool &pool, std::shared_ptr<SignalChannel> sig_channel,
+                                     std::shared_ptr<BatchTuner> tuner)
+    : m_name("PartitionConsumer[" + topic->name() + "/" + std::to_string(partition) + "]"),
+      m_consumer(consumer),
+      m_topic(topic),
+      m_topic_name(topic->name()),
+      m_partition(partition),
+      m_sig_channel(sig_channel),
+      m_pool(pool),
+      m_tuner(tuner) {}
+
+std::vector<int32_t> PartitionConsumer::partitions_for(RdKafka::Handle *handle, RdKafka::Topic *topic,
+                                                       std::string &errstr) {
+    std::vector<int32_t> partitions;
+    RdKafka::Metadata *metadata = nullptr;
+
+    RdKafka::ErrorCode err = handle->metadata(false, topic, &metadata, 5000);
+    if (err != RdKafka::ERR_NO_ERROR) {
+        errstr = "Failed to fetch metadata for topic '" + topic->name() + "': " + RdKafka::err2str(err);
+        return partitions;
+    }
+
+    for (const RdKafka::TopicMetadata *topic_metadata : *metadata->topics()) {
+        if (topic_metadata->err() != RdKafka::ERR_NO_ERROR) {
+            errstr = "Topic '" + topic_metadata->topic() + "' is not available: " +
+                     RdKafka::err2str(topic_metadata->err());
+            continue;
+        }
+        for (const RdKafka::PartitionMetadata *partition_metadata : *topic_metadata->partitions()) {
+            partitions.push_back(partition_metadata->id());
+        }
+    }
+    delete metadata;
+
+    std::sort(partitions.begin(), partitions.end());
+    return partitions;
+}
+
+bool PartitionConsumer::start(int64_t start_offset) {
+    RdKafka::ErrorCode resp = m_consumer->start(m_topic, m_partition, start_offset);
+    if (resp != RdKafka::ERR_NO_ERROR) {
+        Logging::ERROR("Failed to start consumer: " + RdKafka::err2str(resp), m_name);
+        return false;
+    }
+
+    m_t = std::make_unique<std::thread>(&PartitionConsumer::run, this);
+    Logging::INFO("Started", m_name);
+    return true;
+}
+
+void PartitionConsumer::join() const {
+    if (m_t) {
+        ThreadGuard g(*m_t);
+    }
+}
+
+size_t PartitionConsumer::errors() const { return m_errors; }
+
+/*
+Blocks for up to one second for the first message. Once a message has arrived, keeps collecting until the batch
+is full or the linger time has passed. Returns false if nothing was consumed.
+*/
+bool PartitionConsumer::consume_batch(MessageBatch &batch) {
+    int timeout_ms = 1000;
+    std::chrono::steady_clock::time_point deadline;
+    size_t batch_size = m_tuner->batch_size();
+    std::chrono::milliseconds linger = m_tuner->linger();
+
+    while (batch.size() < batch_size) {
+        RdKafka::Message *msg = m_consumer->consume(m_topic, m_partition, timeout_ms);
+        switch (msg->err()) {
+            case RdKafka::ERR_NO_ERROR:
+                if (batch.empty()) {
+                    deadline = std::chrono::steady_clock::now() + linger;
+                }
+                // The decode worker owns the message from here on
+                batch.push_back(msg);
+                msg = nullptr;
+                break;
+            case RdKafka::ERR__TIMED_OUT:
+            case RdKafka::ERR__PARTITION_EOF:
+                break;
+            default:
+                ++m_errors;
+                LOG_PER_SECOND(ERROR, m_name, 10, "Consume failed: {}", msg->errstr());
+        }
+        bool idle = msg != nullptr;
+        delete msg;
+
+        if (batch.empty() || (idle && linger.count() == 0)) {
+            break;
+        }
+
+        auto remaining =
+            std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() < 0) {
+            break;
+        }
+        timeout_ms = static_cast<int>(remaining.count());
+    }
+
+    return !batch.empty();
+}
+
+/*
+Pausing stops librdkafka from fetching more of the partition while the worker catches up
+*/
+void PartitionConsumer::wait_for_pool() {
+    std::vector<RdKafka::TopicPartition *> partitions = {RdKafka::TopicPartition::create(m_topic_name, m_partition)};
+    m_consumer->pause(partitions);
+    LOG_DEBUG(m_name, "Paused until the decode worker has caught up");
+
+    while (!m_sig_channel->m_shutdown_requested.load() &&
+           !m_pool.wait_until_relieved(m_topic_name, m_partition, std::chrono::milliseconds(100))) {
+    }
+
+    m_consumer->resume(partitions);
+    RdKafka::TopicPartition::destroy(partitions);
+    LOG_DEBUG(m_name, "Resumed");
+}
+
+void PartitionConsumer::run() {
+    /*
+     * Consume messages
+     * https://github.com/confluentinc/librdkafka/blob/master/examples/rdkafka_example.cpp
+     */
+    MessageBatch batch;
+    while (!m_sig_channel->m_shutdown_requested.load()) {
+        batch.reserve(m_tuner->batch_size());
+        if (consume_batch(batch)) {
+            m_pool.dispatch(std::move(batch));
+            batch = MessageBatch();
+        }
+        if (m_pool.congested(m_topic_name, m_partition)) {
+            wait_for_pool();
+        }
+    }
+
+    m_consumer->stop(m_topic, m_partition);
+    Logging::INFO("Shutting down", m_name);
+}
+
+PartitionConsumer::~PartitionConsumer() {}
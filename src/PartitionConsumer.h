@@ -0,0 +1,52 @@
+/**
+ * Consumes a single partition of a topic on a dedicated thread.
+ *
+ * The legacy consumer allows concurrent consume() calls on distinct partitions, so one PartitionConsumer
+ * is started for every partition of every topic listed in the type_map. Consumed messages are collected into
+ * batches of up to the BatchTuner's batch size, waiting at most its linger after the first one, and every batch is
+ * handed off to the DecodePool in one go; only consume errors are dealt with on this thread. While the decode
+ * worker of the partition is congested, the partition is paused and the thread waits for the worker to catch up.
+ **/
+#ifndef PARTITION_CONSUMER_H
+#define PARTITION_CONSUMER_H
+
+#include <librdkafka/rdkafkacpp.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BatchTuner.h"
+#include "DecodePool.h"
+#include "SignalChannel.h"
+
+class PartitionConsumer {
+   public:
+    PartitionConsumer(RdKafka::Consumer *consumer, RdKafka::Topic *topic, int32_t partition, DecodePool &pool,
+                      std::shared_ptr<SignalChannel> sig_channel, std::shared_ptr<BatchTuner> tuner);
+    bool start(int64_t start_offset);
+    void join() const;
+    size_t errors() const;
+    ~PartitionConsumer();
+
+    static std::vector<int32_t> partitions_for(RdKafka::Handle *handle, RdKafka::Topic *topic, std::string &errstr);
+
+   private:
+    const std::string m_name;
+    RdKafka::Consumer *m_consumer;
+    RdKafka::Topic *m_topic;
+    const std::string m_topic_name;
+    int32_t m_partition;
+    std::shared_ptr<SignalChannel> m_sig_channel;
+    DecodePool &m_pool;
+    std::shared_ptr<BatchTuner> m_tuner;
+    std::unique_ptr<std::thread> m_t;
+    size_t m_errors = 0;
+    bool consume_batch(MessageBatch &batch);
+    void wait_for_pool();
+    void run();
+};
+
+#endif
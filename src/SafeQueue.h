@@ -4,6 +4,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <queue>
+#include <utility>
 
 // A threadsafe-queue.
 template <typename T>
@@ -16,7 +17,7 @@ class SafeQueue {
     // Add an element to the queue.
     void enqueue(T t) {
         std::lock_guard<std::mutex> lock(m_mutex);
-        m_queue.push(t);
+        m_queue.push(std::move(t));
         m_cv.notify_all();
     }
 
@@ -28,7 +29,7 @@ class SafeQueue {
             // release lock as long as the wait and reaquire it afterwards.
             m_cv.wait(lock);
         }
-        T val = m_queue.front();
+        T val = std::move(m_queue.front());
         m_queue.pop();
         return val;
     }
@@ -41,7 +42,7 @@ class SafeQueue {
         });
 
         if (!m_queue.empty()) {
-            val = m_queue.front();
+            val = std::move(m_queue.front());
             m_queue.pop();
         }
     }
@@ -10,6 +10,12 @@
 
 static const std::string name = "SchemaRegistry";
 
+/*
+Decoders keep the state of the message they are decoding, so they cannot be shared between threads. Every thread
+gets its own decoder per (writer id, reader id) pair, built from the schemas in the shared cache on first use.
+*/
+static thread_local std::map<std::pair<int32_t, int32_t>, avro::DecoderPtr> decoders;
+
 SchemaRegistry::SchemaRegistry(const std::string *h) {
     if (h) {
         Serdes::Conf *m_sconf = Serdes::Conf::create();
@@ -141,6 +147,77 @@ Serdes::Schema *SchemaRegistry::fetch_value_schema(const std::string &schema_nam
 //     std::cout << "JSON: " << out << std::endl;
 // }
 
+int32_t SchemaRegistry::schema_id(const void *payload, size_t len) {
+    const uint8_t *p = static_cast<const uint8_t *>(payload);
+    if (!p || len < CP1_FRAMING_SIZE || p[0] != 0) {
+        return -1;
+    }
+    uint32_t id = (uint32_t(p[1]) << 24) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 8) | uint32_t(p[4]);
+    return static_cast<int32_t>(id);
+}
+
+std::shared_ptr<const avro::ValidSchema> SchemaRegistry::schema_for_id(int32_t id, std::string &errstr) {
+    {
+        std::shared_lock lock(m_schemas_mutex);
+        auto found = m_schemas.find(id);
+        if (found != m_schemas.end()) {
+            return found->second;
+        }
+    }
+
+    // Misses are fetched under the exclusive lock so that concurrent misses for the same id hit the registry once
+    std::unique_lock lock(m_schemas_mutex);
+    auto found = m_schemas.find(id);
+    if (found != m_schemas.end()) {
+        return found->second;
+    }
+
+    Serdes::Schema *schema = Serdes::Schema::get(m_serdes, id, errstr);
+    if (!schema) {
+        errstr = "Failed to fetch schema with id " + std::to_string(id) + ": " + errstr;
+        return nullptr;
+    }
+    auto avro_schema = std::make_shared<const avro::ValidSchema>(*schema->object());
+    Logging::INFO("Cached schema '" + schema->name() + "', id: " + std::to_string(id), name);
+    delete schema;
+
+    m_schemas.emplace(id, avro_schema);
+    return avro_schema;
+}
+
+avro::DecoderPtr SchemaRegistry::decoder_for(int32_t writer_id, int32_t reader_id, std::string &errstr) {
+    if (reader_id < 0) {
+        reader_id = writer_id;
+    }
+
+    auto key = std::make_pair(writer_id, reader_id);
+    auto found = decoders.find(key);
+    if (found != decoders.end()) {
+        return found->second;
+    }
+
+    avro::DecoderPtr decoder;
+    if (writer_id == reader_id) {
+        decoder = avro::binaryDecoder();
+    } else {
+        std::shared_ptr<const avro::ValidSchema> writer = schema_for_id(writer_id, errstr);
+        std::shared_ptr<const avro::ValidSchema> reader = schema_for_id(reader_id, errstr);
+        if (!writer || !reader) {
+            return nullptr;
+        }
+        try {
+            decoder = avro::resolvingDecoder(*writer, *reader, avro::binaryDecoder());
+        } catch (const avro::Exception &e) {
+            errstr = "Cannot resolve writer schema " + std::to_string(writer_id) + " against reader schema " +
+                     std::to_string(reader_id) + ": " + e.what();
+            return nullptr;
+        }
+    }
+
+    decoders.emplace(key, decoder);
+    return decoder;
+}
+
 int SchemaRegistry::register_value_schema(const std::string &schema_name, const std::string &schema_def) {
     std::string errstr;
     Serdes::Schema *schema = Serdes::Schema::add(m_serdes, schema_name + "-value", schema_def, errstr);
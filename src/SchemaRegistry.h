@@ -13,8 +13,13 @@
 #include <avro/Schema.hh>
 #include <avro/Specific.hh>
 #include <avro/ValidSchema.hh>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 class SchemaRegistry {
    private:
@@ -22,6 +27,13 @@ class SchemaRegistry {
     SchemaRegistry(const std::string *h);
     static SchemaRegistry &instance_impl(const std::string *h);
 
+    /*
+    Parsed schemas keyed by the id found in the CP1 framing. Schemas never change for a given id, so entries are
+    never evicted.
+    */
+    std::shared_mutex m_schemas_mutex;
+    std::unordered_map<int32_t, std::shared_ptr<const avro::ValidSchema>> m_schemas;
+
    public:
     Serdes::Avro *m_serdes;
     SchemaRegistry(const SchemaRegistry &) = delete;
@@ -34,6 +46,15 @@ class SchemaRegistry {
     int fetch_value_schema_id(const std::string &schema_name);
     Serdes::Schema *fetch_value_schema(const std::string &schema_name);
     int register_value_schema(const std::string &schema_name, const std::string &schema_def);
+
+    /*
+    CP1 framing: a zero magic byte followed by the big-endian schema id
+    */
+    static constexpr size_t CP1_FRAMING_SIZE = 5;
+    static int32_t schema_id(const void *payload, size_t len);
+
+    std::shared_ptr<const avro::ValidSchema> schema_for_id(int32_t id, std::string &errstr);
+    avro::DecoderPtr decoder_for(int32_t writer_id, int32_t reader_id, std::string &errstr);
 };
 
 #endif
\ No newline at end of file
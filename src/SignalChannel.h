@@ -3,6 +3,13 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
 
 class SignalChannel
 {
@@ -10,6 +17,27 @@ public:
     std::atomic<bool> m_shutdown_requested = false;
     std::mutex m_cv_mutex;
     std::condition_variable m_cv;
+#ifdef __linux__
+    // Becomes readable once a shutdown has been requested, for threads that wait in epoll rather than on m_cv
+    const int m_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    ~SignalChannel()
+    {
+        close(m_fd);
+    }
+#endif
+
+    void request_shutdown()
+    {
+        m_shutdown_requested.store(true);
+
+        // notify all waiting workers to check their predicate
+        m_cv.notify_all();
+#ifdef __linux__
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t written = write(m_fd, &one, sizeof(one));
+#endif
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -67,6 +67,64 @@ std::map<std::string, std::string> ConfigParser::column_type_transforms_map() {
 
 std::map<std::string, std::string> ConfigParser::kafka() { return config_for_key("kafka"); }
 
+std::map<std::string, std::string> ConfigParser::decode() {
+    return has_key("decode") ? config_for_key("decode") : std::map<std::string, std::string>();
+}
+
+std::map<std::string, std::string> ConfigParser::database() {
+    return has_key("database") ? config_for_key("database") : std::map<std::string, std::string>();
+}
+
+std::map<std::string, std::string> ConfigParser::logging() {
+    return has_key("logging") ? config_for_key("logging") : std::map<std::string, std::string>();
+}
+
+/*
+The 'sinks' key holds a list of maps, one per sink. Without it, decoded records go to stdout.
+*/
+std::vector<std::map<std::string, std::string>> ConfigParser::sinks() {
+    std::vector<std::map<std::string, std::string>> result;
+    if (!has_key("sinks")) {
+        result.push_back({{"type", "stdout"}});
+        return result;
+    }
+
+    YAML::Node node = m_config["sinks"];
+    if (node.Type() != YAML::NodeType::Sequence) {
+        Logging::ERROR("Value for key 'sinks' is not a list", name);
+        kill(getpid(), SIGINT);
+        return result;
+    }
+
+    for (auto it = node.begin(); it != node.end(); ++it) {
+        if (it->Type() != YAML::NodeType::Map) {
+            Logging::ERROR("Entries of 'sinks' must be maps", name);
+            kill(getpid(), SIGINT);
+            return result;
+        }
+        std::map<std::string, std::string> sink;
+        for (auto field = it->begin(); field != it->end(); ++field) {
+            if (field->second.Type() == YAML::NodeType::Scalar) {
+                sink.insert(std::make_pair(field->first.as<std::string>(), field->second.as<std::string>()));
+            }
+        }
+
+        // A sink that names a type_map topic gets the schema assembled for it
+        if (sink.count("type_map")) {
+            std::map<std::string, SchemaConfig> configs = schema_configs();
+            auto found = configs.find(sink["type_map"]);
+            if (found == configs.end()) {
+                Logging::ERROR("Sink refers to topic '" + sink["type_map"] + "', which is not in the type_map", name);
+                kill(getpid(), SIGINT);
+                return result;
+            }
+            sink["schema"] = assemble_schema(found->second).toJson(false);
+        }
+        result.push_back(std::move(sink));
+    }
+    return result;
+}
+
 std::map<std::string, SchemaConfig> ConfigParser::schema_configs() {
     std::vector<std::string> err;
     std::map<std::string, SchemaConfig> result;
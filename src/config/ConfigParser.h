@@ -37,6 +37,10 @@ class ConfigParser {
     static ConfigParser &instance(std::string c);
     bool has_key(const std::string &k);
     std::map<std::string, std::string> kafka();
+    std::map<std::string, std::string> decode();
+    std::map<std::string, std::string> database();
+    std::map<std::string, std::string> logging();
+    std::vector<std::map<std::string, std::string>> sinks();
     std::map<std::string, std::string> column_map();
     std::map<std::string, std::string> column_type_transforms_map();
     std::map<std::string, SchemaConfig> schemas();
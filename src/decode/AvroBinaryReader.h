@@ -0,0 +1,94 @@
+/**
+ * Cursor over an Avro binary encoded buffer.
+ *
+ * Reads primitives straight from the buffer without copying; strings and bytes are returned as views into it.
+ * Throws avro::Exception when the buffer ends early or holds an invalid varint.
+ **/
+#ifndef AVRO_BINARY_READER_H
+#define AVRO_BINARY_READER_H
+
+#include <avro/Exception.hh>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+class AvroBinaryReader {
+   public:
+    void reset(const uint8_t *data, size_t len) {
+        m_begin = data;
+        m_pos = data;
+        m_end = data + len;
+    }
+
+    size_t consumed() const { return m_pos - m_begin; }
+
+    bool read_bool() {
+        need(1);
+        return *m_pos++ != 0;
+    }
+
+    /*
+    Zig-zag encoded variable length integer
+    */
+    int64_t read_long() {
+        uint64_t value = 0;
+        int shift = 0;
+        uint8_t b;
+        do {
+            if (shift >= 64) {
+                throw avro::Exception("Invalid varint encoding");
+            }
+            need(1);
+            b = *m_pos++;
+            value |= uint64_t(b & 0x7f) << shift;
+            shift += 7;
+        } while (b & 0x80);
+
+        return static_cast<int64_t>((value >> 1) ^ -(value & 1));
+    }
+
+    float read_float() {
+        float f;
+        std::memcpy(&f, advance(sizeof(float)), sizeof(float));
+        return f;
+    }
+
+    double read_double() {
+        double d;
+        std::memcpy(&d, advance(sizeof(double)), sizeof(double));
+        return d;
+    }
+
+    std::string_view read_bytes(size_t len) {
+        return std::string_view(reinterpret_cast<const char *>(advance(len)), len);
+    }
+
+    std::string_view read_bytes() {
+        int64_t len = read_long();
+        if (len < 0) {
+            throw avro::Exception("Negative length " + std::to_string(len));
+        }
+        return read_bytes(static_cast<size_t>(len));
+    }
+
+   private:
+    const uint8_t *m_begin = nullptr;
+    const uint8_t *m_pos = nullptr;
+    const uint8_t *m_end = nullptr;
+
+    void need(size_t len) const {
+        if (static_cast<size_t>(m_end - m_pos) < len) {
+            throw avro::Exception("Unexpected end of payload");
+        }
+    }
+
+    const uint8_t *advance(size_t len) {
+        need(len);
+        const uint8_t *p = m_pos;
+        m_pos += len;
+        return p;
+    }
+};
+
+#endif
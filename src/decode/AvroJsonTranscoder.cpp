@@ -0,0 +1,257 @@
+#include "AvroJsonTranscoder.h"
+
+#include <avro/Exception.hh>
+#include <avro/NodeImpl.hh>
+#include <charconv>
+#include <cmath>
+
+ssize_t AvroJsonTranscoder::transcode(const avro::ValidSchema &schema, const uint8_t *data, size_t len,
+                                      std::string &out, std::string &errstr) {
+    m_reader.reset(data, len);
+    size_t mark = out.size();
+
+    try {
+        node(schema.root(), out);
+    } catch (const avro::Exception &e) {
+        out.resize(mark);
+        errstr = std::string("Binary to JSON transcoding failed: ") + e.what();
+        return -1;
+    }
+
+    return m_reader.consumed();
+}
+
+void AvroJsonTranscoder::node(const avro::NodePtr &n, std::string &out) {
+    switch (n->type()) {
+        case avro::AVRO_NULL:
+            out.append("null");
+            break;
+        case avro::AVRO_BOOL:
+            out.append(m_reader.read_bool() ? "true" : "false");
+            break;
+        case avro::AVRO_INT:
+        case avro::AVRO_LONG:
+            append_number(m_reader.read_long(), out);
+            break;
+        case avro::AVRO_FLOAT:
+            append_number(m_reader.read_float(), out);
+            break;
+        case avro::AVRO_DOUBLE:
+            append_number(m_reader.read_double(), out);
+            break;
+        case avro::AVRO_STRING:
+            append_string(m_reader.read_bytes(), out);
+            break;
+        case avro::AVRO_BYTES:
+            append_latin1(m_reader.read_bytes(), out);
+            break;
+        case avro::AVRO_FIXED:
+            append_latin1(m_reader.read_bytes(n->fixedSize()), out);
+            break;
+        case avro::AVRO_ENUM: {
+            int64_t index = m_reader.read_long();
+            if (index < 0 || static_cast<size_t>(index) >= n->names()) {
+                throw avro::Exception("Enum index " + std::to_string(index) + " out of range");
+            }
+            append_string(n->nameAt(index), out);
+            break;
+        }
+        case avro::AVRO_RECORD:
+            out.push_back('{');
+            for (size_t i = 0; i < n->leaves(); ++i) {
+                if (i) {
+                    out.push_back(',');
+                }
+                append_string(n->nameAt(i), out);
+                out.push_back(':');
+                node(n->leafAt(i), out);
+            }
+            out.push_back('}');
+            break;
+        case avro::AVRO_ARRAY:
+        case avro::AVRO_MAP: {
+            bool is_map = n->type() == avro::AVRO_MAP;
+            const avro::NodePtr &items = is_map ? n->leafAt(1) : n->leafAt(0);
+            bool first = true;
+            out.push_back(is_map ? '{' : '[');
+            // Items come in blocks. A negative count is followed by the block size in bytes, which we don't need.
+            for (int64_t count = m_reader.read_long(); count != 0; count = m_reader.read_long()) {
+                if (count < 0) {
+                    count = -count;
+                    m_reader.read_long();
+                }
+                for (int64_t i = 0; i < count; ++i) {
+                    if (!first) {
+                        out.push_back(',');
+                    }
+                    first = false;
+                    if (is_map) {
+                        append_string(m_reader.read_bytes(), out);
+                        out.push_back(':');
+                    }
+                    node(items, out);
+                }
+            }
+            out.push_back(is_map ? '}' : ']');
+            break;
+        }
+        case avro::AVRO_UNION:
+            union_branch(n, out);
+            break;
+        case avro::AVRO_SYMBOLIC:
+            node(avro::resolveSymbol(n), out);
+            break;
+        default:
+            throw avro::Exception("Unsupported Avro type " + std::to_string(n->type()));
+    }
+}
+
+void AvroJsonTranscoder::union_branch(const avro::NodePtr &n, std::string &out) {
+    int64_t index = m_reader.read_long();
+    if (index < 0 || static_cast<size_t>(index) >= n->leaves()) {
+        throw avro::Exception("Union index " + std::to_string(index) + " out of range");
+    }
+
+    const avro::NodePtr &branch = n->leafAt(index);
+    if (branch->type() == avro::AVRO_NULL) {
+        out.append("null");
+        return;
+    }
+
+    std::string_view opening = branch_openings(n)[index];
+    out.append(opening);
+    node(branch, out);
+    out.push_back('}');
+}
+
+const std::vector<std::string> &AvroJsonTranscoder::branch_openings(const avro::NodePtr &n) {
+    auto found = m_unions.find(n.get());
+    if (found == m_unions.end()) {
+        UnionBranches branches{n, std::vector<std::string>(n->leaves())};
+        for (size_t i = 0; i < n->leaves(); ++i) {
+            std::string &opening = branches.openings[i];
+            opening.push_back('{');
+            append_string(type_name(n->leafAt(i)), opening);
+            opening.push_back(':');
+        }
+        found = m_unions.emplace(n.get(), std::move(branches)).first;
+    }
+    return found->second.openings;
+}
+
+void AvroJsonTranscoder::append_number(int64_t value, std::string &out) {
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, res.ptr);
+}
+
+/*
+Floating point values are written in their shortest round-trip form. Non-finite values have no JSON number
+representation and are written as strings, like avro::jsonEncoder does.
+*/
+template <typename T>
+static void append_floating(T value, std::string &out) {
+    if (std::isnan(value)) {
+        out.append("\"NaN\"");
+    } else if (std::isinf(value)) {
+        out.append(value > 0 ? "\"Infinity\"" : "\"-Infinity\"");
+    } else {
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, res.ptr);
+    }
+}
+
+void AvroJsonTranscoder::append_number(float value, std::string &out) { append_floating(value, out); }
+
+void AvroJsonTranscoder::append_number(double value, std::string &out) { append_floating(value, out); }
+
+void AvroJsonTranscoder::append_string(std::string_view s, std::string &out) {
+    static const char hex[] = "0123456789abcdef";
+
+    out.push_back('"');
+    size_t plain = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.append(s.data() + plain, i - plain);
+        plain = i + 1;
+        switch (c) {
+            case '"':
+                out.append("\\\"");
+                break;
+            case '\\':
+                out.append("\\\\");
+                break;
+            case '\b':
+                out.append("\\b");
+                break;
+            case '\f':
+                out.append("\\f");
+                break;
+            case '\n':
+                out.append("\\n");
+                break;
+            case '\r':
+                out.append("\\r");
+                break;
+            case '\t':
+                out.append("\\t");
+                break;
+            default:
+                out.append("\\u00");
+                out.push_back(hex[c >> 4]);
+                out.push_back(hex[c & 0xf]);
+        }
+    }
+    out.append(s.data() + plain, s.size() - plain);
+    out.push_back('"');
+}
+
+/*
+Bytes and fixed are written as a string with one code point per byte
+*/
+void AvroJsonTranscoder::append_latin1(std::string_view s, std::string &out) {
+    static const char hex[] = "0123456789abcdef";
+
+    out.push_back('"');
+    for (unsigned char c : s) {
+        if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\') {
+            out.push_back(c);
+        } else {
+            out.append("\\u00");
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 0xf]);
+        }
+    }
+    out.push_back('"');
+}
+
+std::string AvroJsonTranscoder::type_name(const avro::NodePtr &n) {
+    switch (n->type()) {
+        case avro::AVRO_STRING:
+            return "string";
+        case avro::AVRO_BYTES:
+            return "bytes";
+        case avro::AVRO_INT:
+            return "int";
+        case avro::AVRO_LONG:
+            return "long";
+        case avro::AVRO_FLOAT:
+            return "float";
+        case avro::AVRO_DOUBLE:
+            return "double";
+        case avro::AVRO_BOOL:
+            return "boolean";
+        case avro::AVRO_ARRAY:
+            return "array";
+        case avro::AVRO_MAP:
+            return "map";
+        case avro::AVRO_SYMBOLIC:
+            return type_name(avro::resolveSymbol(n));
+        default:
+            return n->name().fullname();
+    }
+}
@@ -0,0 +1,57 @@
+/**
+ * Streams Avro binary straight into JSON by walking the writer schema once.
+ *
+ * The output follows the Avro JSON encoding that avro::jsonEncoder produces for a decoded GenericDatum (unions as
+ * {"type": value}, bytes and fixed as strings of code points 0-255), but no datum is built in between and the JSON
+ * is appended to a buffer owned by the caller, so steady-state transcoding does not allocate.
+ **/
+#ifndef AVRO_JSON_TRANSCODER_H
+#define AVRO_JSON_TRANSCODER_H
+
+#include <sys/types.h>
+
+#include <avro/Schema.hh>
+#include <avro/ValidSchema.hh>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "AvroBinaryReader.h"
+
+class AvroJsonTranscoder {
+   public:
+    /*
+    Appends the JSON for the datum in [data, data + len) to out. Returns the number of bytes read, or -1 with errstr
+    set, in which case out is left as it was.
+    */
+    ssize_t transcode(const avro::ValidSchema &schema, const uint8_t *data, size_t len, std::string &out,
+                      std::string &errstr);
+
+    static void append_string(std::string_view s, std::string &out);
+    static void append_latin1(std::string_view s, std::string &out);
+    static void append_number(int64_t value, std::string &out);
+    static void append_number(float value, std::string &out);
+    static void append_number(double value, std::string &out);
+    static std::string type_name(const avro::NodePtr &n);
+
+   private:
+    /*
+    The opening {"type": of every branch of a union, built the first time the union is met. The node is kept alive
+    so that its address, which the cache is keyed by, cannot be taken by another node.
+    */
+    struct UnionBranches {
+        avro::NodePtr node;
+        std::vector<std::string> openings;
+    };
+
+    AvroBinaryReader m_reader;
+    std::unordered_map<const avro::Node *, UnionBranches> m_unions;
+
+    void node(const avro::NodePtr &n, std::string &out);
+    void union_branch(const avro::NodePtr &n, std::string &out);
+    const std::vector<std::string> &branch_openings(const avro::NodePtr &n);
+};
+
+#endif
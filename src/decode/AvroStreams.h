@@ -0,0 +1,76 @@
+/**
+ * Reusable Avro streams for decoders and encoders that are initialised again for every message.
+ *
+ * avro::memoryInputStream() and avro::ostreamOutputStream() allocate a new stream (and buffers) per call.
+ * BufferInputStream is pointed at the next payload with reset() and StringOutputStream appends straight to a
+ * caller owned string, so once that string has grown to its working size neither allocates.
+ **/
+#ifndef AVRO_STREAMS_H
+#define AVRO_STREAMS_H
+
+#include <algorithm>
+#include <avro/Stream.hh>
+#include <string>
+
+class BufferInputStream : public avro::InputStream {
+   public:
+    void reset(const uint8_t *data, size_t len) {
+        m_data = data;
+        m_len = len;
+        m_pos = 0;
+    }
+
+    bool next(const uint8_t **data, size_t *len) override {
+        if (m_pos == m_len) {
+            return false;
+        }
+        *data = m_data + m_pos;
+        *len = m_len - m_pos;
+        m_pos = m_len;
+        return true;
+    }
+
+    void backup(size_t len) override { m_pos -= len; }
+
+    void skip(size_t len) override { m_pos = std::min(m_len, m_pos + len); }
+
+    size_t byteCount() const override { return m_pos; }
+
+   private:
+    const uint8_t *m_data = nullptr;
+    size_t m_len = 0;
+    size_t m_pos = 0;
+};
+
+class StringOutputStream : public avro::OutputStream {
+   public:
+    StringOutputStream(std::string &out) : m_out(out) {}
+
+    /*
+    Hands out the unused capacity of the string, growing it only when it is full
+    */
+    bool next(uint8_t **data, size_t *len) override {
+        size_t size = m_out.size();
+        size_t available = std::max<size_t>(m_out.capacity() - size, 256);
+        m_out.resize(size + available);
+        *data = reinterpret_cast<uint8_t *>(&m_out[size]);
+        *len = available;
+        m_count += available;
+        return true;
+    }
+
+    void backup(size_t len) override {
+        m_out.resize(m_out.size() - len);
+        m_count -= len;
+    }
+
+    uint64_t byteCount() const override { return m_count; }
+
+    void flush() override {}
+
+   private:
+    std::string &m_out;
+    uint64_t m_count = 0;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "DecodePlan.h"
+
+#include <avro/Exception.hh>
+#include <avro/NodeImpl.hh>
+
+#include "AvroJsonTranscoder.h"
+
+const FieldValue *FlatRecord::field(std::string_view name) const {
+    ssize_t i = plan ? plan->field_index(name) : -1;
+    return i < 0 ? nullptr : &fields[i];
+}
+
+std::unique_ptr<DecodePlan> DecodePlan::compile(const avro::ValidSchema &schema, std::string &errstr) {
+    const avro::NodePtr &root = schema.root();
+    if (root->type() != avro::AVRO_RECORD) {
+        errstr = "Only record schemas can be compiled";
+        return nullptr;
+    }
+
+    auto plan = std::make_unique<DecodePlan>();
+    for (size_t i = 0; i < root->leaves(); ++i) {
+        Instruction instruction;
+        instruction.name = root->nameAt(i);
+        if (i) {
+            instruction.json_key.push_back(',');
+        }
+        AvroJsonTranscoder::append_string(instruction.name, instruction.json_key);
+        instruction.json_key.push_back(':');
+
+        avro::NodePtr field = root->leafAt(i);
+        if (field->type() == avro::AVRO_UNION) {
+            instruction.is_union = true;
+            for (size_t b = 0; b < field->leaves(); ++b) {
+                Branch branch;
+                if (!compile_branch(field->leafAt(b), branch, errstr)) {
+                    errstr = "Field '" + instruction.name + "': " + errstr;
+                    return nullptr;
+                }
+                if (branch.kind != FieldValue::Kind::NUL) {
+                    branch.json_open.push_back('{');
+                    AvroJsonTranscoder::append_string(AvroJsonTranscoder::type_name(field->leafAt(b)),
+                                                      branch.json_open);
+                    branch.json_open.push_back(':');
+                }
+                instruction.branches.push_back(std::move(branch));
+            }
+        } else {
+            Branch branch;
+            if (!compile_branch(field, branch, errstr)) {
+                errstr = "Field '" + instruction.name + "': " + errstr;
+                return nullptr;
+            }
+            instruction.branches.push_back(std::move(branch));
+        }
+
+        plan->m_program.push_back(std::move(instruction));
+    }
+
+    return plan;
+}
+
+bool DecodePlan::compile_branch(const avro::NodePtr &node, Branch &branch, std::string &errstr) {
+    avro::NodePtr n = node->type() == avro::AVRO_SYMBOLIC ? avro::resolveSymbol(node) : node;
+
+    switch (n->type()) {
+        case avro::AVRO_NULL:
+            branch.kind = FieldValue::Kind::NUL;
+            return true;
+        case avro::AVRO_BOOL:
+            branch.kind = FieldValue::Kind::BOOL;
+            return true;
+        case avro::AVRO_INT:
+        case avro::AVRO_LONG:
+            branch.kind = FieldValue::Kind::LONG;
+            return true;
+        case avro::AVRO_FLOAT:
+            branch.kind = FieldValue::Kind::FLOAT;
+            return true;
+        case avro::AVRO_DOUBLE:
+            branch.kind = FieldValue::Kind::DOUBLE;
+            return true;
+        case avro::AVRO_STRING:
+            branch.kind = FieldValue::Kind::STRING;
+            return true;
+        case avro::AVRO_BYTES:
+            branch.kind = FieldValue::Kind::BYTES;
+            return true;
+        case avro::AVRO_FIXED:
+            branch.kind = FieldValue::Kind::BYTES;
+            branch.fixed_size = n->fixedSize();
+            return true;
+        case avro::AVRO_ENUM:
+            branch.kind = FieldValue::Kind::ENUM;
+            for (size_t i = 0; i < n->names(); ++i) {
+                branch.symbols.push_back(n->nameAt(i));
+            }
+            return true;
+        default:
+            errstr = "Type " + AvroJsonTranscoder::type_name(n) + " cannot be compiled into a decode plan";
+            return false;
+    }
+}
+
+ssize_t DecodePlan::decode(const uint8_t *data, size_t len, FlatRecord &record, std::string &errstr) const {
+    AvroBinaryReader reader;
+    reader.reset(data, len);
+    record.plan = this;
+    record.fields.resize(m_program.size());
+
+    try {
+        for (size_t i = 0; i < m_program.size(); ++i) {
+            const Instruction &instruction = m_program[i];
+            FieldValue &value = record.fields[i];
+
+            value.branch = 0;
+            if (instruction.is_union) {
+                int64_t index = reader.read_long();
+                if (index < 0 || static_cast<size_t>(index) >= instruction.branches.size()) {
+                    throw avro::Exception("Union index " + std::to_string(index) + " out of range");
+                }
+                value.branch = static_cast<uint32_t>(index);
+            }
+
+            const Branch &branch = instruction.branches[value.branch];
+            value.kind = branch.kind;
+            switch (branch.kind) {
+                case FieldValue::Kind::NUL:
+                    break;
+                case FieldValue::Kind::BOOL:
+                    value.l = reader.read_bool();
+                    break;
+                case FieldValue::Kind::LONG:
+                    value.l = reader.read_long();
+                    break;
+                case FieldValue::Kind::FLOAT:
+                    value.d = reader.read_float();
+                    break;
+                case FieldValue::Kind::DOUBLE:
+                    value.d = reader.read_double();
+                    break;
+                case FieldValue::Kind::STRING:
+                    value.s = reader.read_bytes();
+                    break;
+                case FieldValue::Kind::BYTES:
+                    value.s = branch.fixed_size ? reader.read_bytes(branch.fixed_size) : reader.read_bytes();
+                    break;
+                case FieldValue::Kind::ENUM:
+                    value.l = reader.read_long();
+                    if (value.l < 0 || static_cast<size_t>(value.l) >= branch.symbols.size()) {
+                        throw avro::Exception("Enum index " + std::to_string(value.l) + " out of range");
+                    }
+                    value.s = branch.symbols[value.l];
+                    break;
+            }
+        }
+    } catch (const avro::Exception &e) {
+        errstr = std::string("Plan decoding failed: ") + e.what();
+        return -1;
+    }
+
+    return reader.consumed();
+}
+
+void DecodePlan::to_json(const FlatRecord &record, std::string &out) const {
+    out.push_back('{');
+    for (size_t i = 0; i < m_program.size(); ++i) {
+        const Instruction &instruction = m_program[i];
+        const FieldValue &value = record.fields[i];
+        const Branch &branch = instruction.branches[value.branch];
+
+        out.append(instruction.json_key);
+        out.append(branch.json_open);
+        switch (value.kind) {
+            case FieldValue::Kind::NUL:
+                out.append("null");
+                break;
+            case FieldValue::Kind::BOOL:
+                out.append(value.l ? "true" : "false");
+                break;
+            case FieldValue::Kind::LONG:
+                AvroJsonTranscoder::append_number(value.l, out);
+                break;
+            case FieldValue::Kind::FLOAT:
+                AvroJsonTranscoder::append_number(static_cast<float>(value.d), out);
+                break;
+            case FieldValue::Kind::DOUBLE:
+                AvroJsonTranscoder::append_number(value.d, out);
+                break;
+            case FieldValue::Kind::STRING:
+            case FieldValue::Kind::ENUM:
+                AvroJsonTranscoder::append_string(value.s, out);
+                break;
+            case FieldValue::Kind::BYTES:
+                AvroJsonTranscoder::append_latin1(value.s, out);
+                break;
+        }
+        if (!branch.json_open.empty()) {
+            out.push_back('}');
+        }
+    }
+    out.push_back('}');
+}
+
+size_t DecodePlan::size() const { return m_program.size(); }
+
+const std::string &DecodePlan::field_name(size_t i) const { return m_program[i].name; }
+
+ssize_t DecodePlan::field_index(std::string_view name) const {
+    for (size_t i = 0; i < m_program.size(); ++i) {
+        if (m_program[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,81 @@
+/**
+ * A record schema compiled into a flat list of field instructions.
+ *
+ * A plan is built once per writer schema and executed with a single switch per field. It decodes into a
+ * FlatRecord whose string and bytes values are views into the message payload, so there is no datum tree, no
+ * virtual dispatch and no allocation per field. Only records whose fields are primitives, enums, fixed or unions
+ * of those can be compiled; compile() returns nullptr for anything else so the caller can fall back to the
+ * transcoder.
+ **/
+#ifndef DECODE_PLAN_H
+#define DECODE_PLAN_H
+
+#include <sys/types.h>
+
+#include <avro/ValidSchema.hh>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AvroBinaryReader.h"
+
+class DecodePlan;
+
+struct FieldValue {
+    enum class Kind : uint8_t { NUL, BOOL, LONG, FLOAT, DOUBLE, STRING, BYTES, ENUM };
+
+    Kind kind = Kind::NUL;
+    uint32_t branch = 0;  // Union branch the value was written with
+    int64_t l = 0;        // bool, int, long and enum index
+    double d = 0;         // float and double
+    std::string_view s;   // string, bytes, fixed and enum symbol; points into the payload or the plan
+};
+
+/*
+Fields in schema order. Meant to be reused across messages so that decoding does not allocate once the vector
+has grown to the size of the record.
+*/
+struct FlatRecord {
+    const DecodePlan *plan = nullptr;
+    std::vector<FieldValue> fields;
+
+    const FieldValue *field(std::string_view name) const;
+};
+
+class DecodePlan {
+   public:
+    static std::unique_ptr<DecodePlan> compile(const avro::ValidSchema &schema, std::string &errstr);
+
+    /*
+    Decodes the record in [data, data + len). Returns the number of bytes read, or -1 with errstr set.
+    */
+    ssize_t decode(const uint8_t *data, size_t len, FlatRecord &record, std::string &errstr) const;
+    void to_json(const FlatRecord &record, std::string &out) const;
+
+    size_t size() const;
+    const std::string &field_name(size_t i) const;
+    ssize_t field_index(std::string_view name) const;
+
+   private:
+    struct Branch {
+        FieldValue::Kind kind;
+        size_t fixed_size = 0;  // Non-zero for fixed, which has no length prefix
+        std::vector<std::string> symbols;
+        std::string json_open;  // {"type": for non-null union branches
+    };
+
+    struct Instruction {
+        std::string name;
+        std::string json_key;  // "name": including the separator from the previous field
+        bool is_union = false;
+        std::vector<Branch> branches;
+    };
+
+    std::vector<Instruction> m_program;
+
+    static bool compile_branch(const avro::NodePtr &n, Branch &branch, std::string &errstr);
+};
+
+#endif
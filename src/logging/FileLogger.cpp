@@ -44,9 +44,38 @@ void Logging::FileLogger::log(const std::string &message, const Level level)
 }
 
 void Logging::FileLogger::log(const std::string &message)
+{
+    write(message);
+}
+
+void Logging::FileLogger::log_batch(std::span<const std::string> messages)
+{
+    write(join(messages));
+}
+
+/*
+The file is flushed and checked for reopening after every write, or only once a flush is due when a flush
+interval is configured
+*/
+void Logging::FileLogger::write(const std::string &text)
+{
+    m_lock.lock();
+    m_file << text;
+    bool due = flush_due(text.size());
+    if (due)
+    {
+        m_file.flush();
+    }
+    m_lock.unlock();
+    if (due)
+    {
+        reopen();
+    }
+}
+
+void Logging::FileLogger::flush()
 {
     m_lock.lock();
-    m_file << message;
     m_file.flush();
     m_lock.unlock();
     reopen();
@@ -2,15 +2,23 @@
 #include "ThreadGuard.h"
 
 static std::string name = "LogProcessor";
-SafeQueue<std::string> log_queue;
+// Dropping rather than blocking keeps logging from ever stalling the threads that consume and decode
+MpscRingBuffer<Logging::LogRecord> log_queue(Logging::LOG_QUEUE_CAPACITY, MpscRingBuffer<Logging::LogRecord>::Policy::DROP);
 
-Logging::LogProcessor::LogProcessor(std::atomic<size_t> *active_processors, std::condition_variable *log_cv, std::mutex *log_cv_mutex) : m_active_processors(active_processors),
-                                                                                                                                         m_log_cv(log_cv),
-                                                                                                                                         m_log_cv_mutex(log_cv_mutex)
+Logging::LogProcessor::LogProcessor(std::atomic<size_t> *active_processors, std::condition_variable *log_cv, std::mutex *log_cv_mutex, const Config &config) : m_active_processors(active_processors),
+                                                                                                                                                             m_log_cv(log_cv),
+                                                                                                                                                             m_log_cv_mutex(log_cv_mutex)
 {
     // Logging::configure({{"type", "file"}, {"file_name", "flycatcher.log"}, {"reopen_interval", "1"}});
     // Logging::configure({{"type", "std_out"}});
-    Logging::configure({{"type", "daily"}, {"file_name", "logs/flycatcher.log"}, {"hour", "2"}, {"minute", "30"}});
+    if (config.find("type") == config.end())
+    {
+        Logging::configure({{"type", "daily"}, {"file_name", "logs/flycatcher.log"}, {"hour", "2"}, {"minute", "30"}});
+    }
+    else
+    {
+        Logging::configure(config);
+    }
 }
 
 bool Logging::LogProcessor::start()
@@ -26,6 +34,11 @@ void Logging::LogProcessor::join() const
 
 void Logging::LogProcessor::run()
 {
+    std::vector<Logging::LogRecord> batch;
+    batch.reserve(Logging::LOG_BATCH_SIZE);
+    std::vector<std::string> lines(Logging::LOG_BATCH_SIZE);
+    Logging::LogFormatter formatter;
+
     m_should_run = true;
     while (m_should_run)
     {
@@ -61,24 +74,51 @@ void Logging::LogProcessor::run()
         /*
         Read and log
         Important: after unlocking as we don't want to block strategies while waiting for dequeue if queue is empty
-        */
-        std::string message = log_queue.dequeue();
-        Logging::log(message);
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        Block only while the queue is empty. Once there is a record, take everything else that is queued as well,
+        format it here and write it all with a single call, so the processor keeps up with any rate and the queue
+        does not grow.
+        */
+        Logging::LogRecord record;
+        if (!log_queue.dequeue_with_timeout(100, record))
+        {
+            // Nothing to log, so write out what buffered loggers are holding back
+            Logging::flush();
+            continue;
+        }
+        batch.push_back(std::move(record));
+        log_queue.drain(batch, Logging::LOG_BATCH_SIZE - 1);
+        write_batch(batch, lines, formatter);
     } // end while
 
     Logging::log("Shutdown requested. Processing remaining " + std::to_string(log_queue.size()) + " messages...", Logging::Level::INFO, name);
-    std::string msg;
-    log_queue.dequeue_with_timeout(1000, msg);
-    while (!msg.empty())
+    while (log_queue.drain(batch, Logging::LOG_BATCH_SIZE))
     {
-        Logging::log(msg, Logging::Level::INFO);
-        msg.clear();
-        log_queue.dequeue_with_timeout(1000, msg);
+        write_batch(batch, lines, formatter);
     }
 
+    if (log_queue.dropped() || log_queue.overwritten())
+    {
+        size_t lost = log_queue.dropped() + log_queue.overwritten();
+        Logging::log("Log queue was full, dropped " + std::to_string(lost) + " messages", Logging::Level::WARN, name);
+    }
     Logging::log("Shutting down", Logging::Level::INFO, name);
+    Logging::flush();
+}
+
+/*
+Lines are formatted into strings that are kept from batch to batch, so they stop allocating once they have grown
+*/
+void Logging::LogProcessor::write_batch(std::vector<LogRecord> &batch, std::vector<std::string> &lines,
+                                        LogFormatter &formatter)
+{
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        lines[i].clear();
+        formatter.format(batch[i], lines[i]);
+    }
+    Logging::log_batch(std::span<const std::string>(lines.data(), batch.size()));
+    batch.clear();
 }
 
 void Logging::LogProcessor::stop()
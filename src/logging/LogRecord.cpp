@@ -0,0 +1,87 @@
+#include "Logging.h"
+
+#ifdef SPDLOG_FMT_EXTERNAL
+#include <fmt/args.h>
+#else
+#include <spdlog/fmt/bundled/args.h>
+#endif
+
+void Logging::LogRecord::format_to(std::string &out) const
+{
+    fmt::dynamic_format_arg_store<fmt::format_context> store;
+    store.reserve(m_arg_count, 0);
+    for (size_t i = 0; i < m_arg_count; ++i)
+    {
+        const Arg &arg = m_args[i];
+        switch (arg.type)
+        {
+        case Arg::Type::INT:
+            store.push_back(arg.i);
+            break;
+        case Arg::Type::UINT:
+            store.push_back(arg.u);
+            break;
+        case Arg::Type::DOUBLE:
+            store.push_back(arg.d);
+            break;
+        case Arg::Type::BOOL:
+            store.push_back(arg.b);
+            break;
+        case Arg::Type::CHAR:
+            store.push_back(arg.c);
+            break;
+        case Arg::Type::STRING:
+            // Views are stored by reference, the record outlives the formatting
+            store.push_back(fmt::string_view((arg.overflow ? m_overflow.data() : m_text) + arg.s.offset, arg.s.len));
+            break;
+        }
+    }
+
+    try
+    {
+        fmt::vformat_to(std::back_inserter(out), fmt::string_view(format.data(), format.size()), store);
+    }
+    catch (const fmt::format_error &e)
+    {
+        out.append(format);
+        out.append(" (");
+        out.append(e.what());
+        out.append(")");
+    }
+}
+
+/*
+Records carry a steady clock timestamp, which is cheap to take. It is mapped to calendar time relative to when the
+formatter was created.
+*/
+Logging::LogFormatter::LogFormatter() : m_system_base(std::chrono::system_clock::now()),
+                                        m_steady_base(std::chrono::steady_clock::now())
+{
+}
+
+void Logging::LogFormatter::format(const LogRecord &record, std::string &line)
+{
+    auto tp = m_system_base +
+              std::chrono::duration_cast<std::chrono::system_clock::duration>(record.time - m_steady_base);
+    auto since_epoch = std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count();
+
+    // The date, hour and minute are only worked out again when the minute changes
+    int64_t minute = since_epoch / 60000000;
+    if (minute != m_minute)
+    {
+        std::time_t tt = minute * 60;
+        std::tm gmt{};
+        gmtime_r(&tt, &gmt);
+        m_minute = minute;
+        m_minute_prefix = fmt::format("{:04d}/{:02d}/{:02d} {:02d}:{:02d}:", gmt.tm_year + 1900, gmt.tm_mon + 1,
+                                      gmt.tm_mday, gmt.tm_hour, gmt.tm_min);
+    }
+
+    line.append(m_minute_prefix);
+    fmt::format_to(std::back_inserter(line), "{:09.6f}", (since_epoch % 60000000) / 1e6);
+    line.append(prefix.find(record.level)->second);
+    line.append("[");
+    line.append(record.name());
+    line.append("] ");
+    record.format_to(line);
+}
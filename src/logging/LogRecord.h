@@ -0,0 +1,140 @@
+/**
+ * A log event as it travels through log_queue.
+ *
+ * The logging thread only captures what is needed to build the line later: a steady clock timestamp, the level,
+ * the name of the component, the format string literal and the raw arguments. String arguments are copied into a
+ * buffer inside the record and only spill to the heap when they do not fit. Formatting, including turning the
+ * timestamp into calendar time, is left to the LogProcessor thread through LogFormatter.
+ **/
+#ifndef LOG_RECORD_H
+#define LOG_RECORD_H
+
+#include <spdlog/fmt/fmt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace Logging {
+enum class Level : uint8_t { TRACE = 0, DEBUG = 1, INFO = 2, WARN = 3, ERROR = 4 };
+
+class LogRecord {
+   public:
+    static constexpr size_t MAX_ARGS = 8;
+    static constexpr size_t NAME_CAPACITY = 48;
+    static constexpr size_t TEXT_CAPACITY = 192;
+
+    std::chrono::steady_clock::time_point time;
+    Level level = Level::INFO;
+    std::string_view format;  // Always a string literal, so it outlives the record
+
+    void set_name(std::string_view name) {
+        m_name_size = static_cast<uint8_t>(std::min(name.size(), NAME_CAPACITY));
+        std::memcpy(m_name, name.data(), m_name_size);
+    }
+
+    std::string_view name() const { return std::string_view(m_name, m_name_size); }
+
+    template <typename... Args>
+    void capture(const Args &...args) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "Too many arguments for a log record");
+        m_arg_count = 0;
+        m_text_size = 0;
+        m_overflow.clear();
+        (add(args), ...);
+    }
+
+    // Appends the formatted message
+    void format_to(std::string &out) const;
+
+   private:
+    struct Arg {
+        enum class Type : uint8_t { INT, UINT, DOUBLE, BOOL, CHAR, STRING };
+
+        Type type;
+        bool overflow;  // String is in m_overflow rather than m_text
+        union {
+            int64_t i;
+            uint64_t u;
+            double d;
+            bool b;
+            char c;
+            struct {
+                uint32_t offset;
+                uint32_t len;
+            } s;
+        };
+    };
+
+    uint8_t m_name_size = 0;
+    uint8_t m_arg_count = 0;
+    uint16_t m_text_size = 0;
+    char m_name[NAME_CAPACITY];
+    Arg m_args[MAX_ARGS];
+    char m_text[TEXT_CAPACITY];
+    std::string m_overflow;
+
+    void add_string(std::string_view s) {
+        Arg &arg = m_args[m_arg_count++];
+        arg.type = Arg::Type::STRING;
+        arg.s.len = static_cast<uint32_t>(s.size());
+        arg.overflow = s.size() > TEXT_CAPACITY - m_text_size;
+        if (arg.overflow) {
+            arg.s.offset = static_cast<uint32_t>(m_overflow.size());
+            m_overflow.append(s);
+        } else {
+            arg.s.offset = m_text_size;
+            std::memcpy(m_text + m_text_size, s.data(), s.size());
+            m_text_size += s.size();
+        }
+    }
+
+    template <typename T>
+    void add(const T &value) {
+        if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+            add_string(std::string_view(value));
+        } else {
+            Arg &arg = m_args[m_arg_count++];
+            if constexpr (std::is_same_v<T, bool>) {
+                arg.type = Arg::Type::BOOL;
+                arg.b = value;
+            } else if constexpr (std::is_same_v<T, char>) {
+                arg.type = Arg::Type::CHAR;
+                arg.c = value;
+            } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+                arg.type = Arg::Type::INT;
+                arg.i = value;
+            } else if constexpr (std::is_integral_v<T>) {
+                arg.type = Arg::Type::UINT;
+                arg.u = value;
+            } else if constexpr (std::is_floating_point_v<T>) {
+                arg.type = Arg::Type::DOUBLE;
+                arg.d = value;
+            } else {
+                static_assert(std::is_arithmetic_v<T>, "Log arguments must be numbers, booleans or strings");
+            }
+        }
+    }
+};
+
+/*
+Turns records into log lines on the LogProcessor thread, in the same layout as create_log()
+*/
+class LogFormatter {
+   public:
+    LogFormatter();
+    void format(const LogRecord &record, std::string &line);
+
+   private:
+    std::chrono::system_clock::time_point m_system_base;
+    std::chrono::steady_clock::time_point m_steady_base;
+    int64_t m_minute = -1;  // Minute since the epoch that m_minute_prefix was built for
+    std::string m_minute_prefix;
+};
+
+}  // namespace Logging
+#endif
@@ -4,7 +4,6 @@
  **/
 #ifndef LOGGING_H
 #define LOGGING_H
-#define LOGGING_LEVEL_INFO
 
 #include <spdlog/spdlog.h>
 
@@ -22,13 +21,20 @@
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
-#include "SafeQueue.h"
+#include <span>
 
-extern SafeQueue<std::string> log_queue;
+#include "LogRecord.h"
+#include "MpscRingBuffer.h"
+
+extern MpscRingBuffer<Logging::LogRecord> log_queue;
 
 namespace Logging {
-enum class Level : uint8_t { TRACE = 0, DEBUG = 1, INFO = 2, WARN = 3, ERROR = 4 };
+// Log records that can be queued before the full-queue policy of log_queue applies
+constexpr size_t LOG_QUEUE_CAPACITY = 1 << 16;
+// Most log lines the LogProcessor hands to the logger in one call
+constexpr size_t LOG_BATCH_SIZE = 4096;
 
 struct level_hashing_function {
     template <typename T>
@@ -52,11 +58,23 @@ constexpr Level LEVEL_CUTOFF = Level::WARN;
 #elif defined(LOGGING_LEVEL_ERROR)
 constexpr Level LEVEL_CUTOFF = Level::ERROR;
 #elif defined(LOGGING_LEVEL_NONE)
-constexpr Level LEVEL_CUTOFF = Level::ERROR + 1;
+constexpr Level LEVEL_CUTOFF = static_cast<Level>(static_cast<uint8_t>(Level::ERROR) + 1);
 #else
 constexpr Level LEVEL_CUTOFF = Level::INFO;
 #endif
 
+/*
+Level below which log calls are discarded at runtime. LEVEL_CUTOFF decides what is compiled in at all, so the
+runtime level can be raised above it but not lowered below it.
+*/
+inline std::atomic<Level> runtime_level{std::max(Level::INFO, LEVEL_CUTOFF)};
+
+inline void set_level(const Level level) { runtime_level.store(std::max(level, LEVEL_CUTOFF)); }
+
+inline bool enabled(const Level level) {
+    return level >= LEVEL_CUTOFF && level >= runtime_level.load(std::memory_order_relaxed);
+}
+
 /**
     Timestamp as: year/mo/dy hr:mn:sc.xxxxxx
 */
@@ -89,13 +107,70 @@ class BaseLogger {
    protected:
     std::mutex m_lock;
 
+    /*
+    With a flush interval, writes are left in the output buffers and only flushed once the interval has passed or
+    flush_bytes have been written since the last flush. Without one, every write is flushed.
+    */
+    static constexpr size_t DEFAULT_FLUSH_BYTES = 1 << 20;
+    std::chrono::milliseconds m_flush_interval{0};
+    size_t m_flush_bytes = DEFAULT_FLUSH_BYTES;
+    size_t m_unflushed = 0;
+    std::chrono::steady_clock::time_point m_last_flush = std::chrono::steady_clock::now();
+
+    // Accounts for written bytes and tells whether they should be flushed now
+    bool flush_due(size_t written) {
+        if (m_flush_interval.count() == 0) {
+            return true;
+        }
+
+        m_unflushed += written;
+        auto now = std::chrono::steady_clock::now();
+        if (m_unflushed < m_flush_bytes && now - m_last_flush < m_flush_interval) {
+            return false;
+        }
+        m_unflushed = 0;
+        m_last_flush = now;
+        return true;
+    }
+
+    // The lines of a batch, each terminated by a newline
+    static std::string join(std::span<const std::string> messages) {
+        size_t len = 0;
+        for (const std::string &message : messages) {
+            len += message.size() + 1;
+        }
+        std::string joined;
+        joined.reserve(len);
+        for (const std::string &message : messages) {
+            joined.append(message);
+            joined.push_back('\n');
+        }
+        return joined;
+    }
+
    public:
     BaseLogger() = delete;
-    BaseLogger(const Config &) {};
+    BaseLogger(const Config &config) {
+        auto interval = config.find("flush_interval_ms");
+        if (interval != config.end()) {
+            m_flush_interval = std::chrono::milliseconds(std::stoul(interval->second));
+        }
+        auto bytes = config.find("flush_bytes");
+        if (bytes != config.end()) {
+            m_flush_bytes = std::stoul(bytes->second);
+        }
+    };
     virtual ~BaseLogger() {};
     virtual void log(const std::string &, const Level, const std::string &name) {};
     virtual void log(const std::string &message, const Level level) {};
     virtual void log(const std::string &) {};
+    virtual void log_batch(std::span<const std::string> messages) {
+        for (const std::string &message : messages) {
+            log(message);
+        }
+    };
+    // Writes out whatever is buffered
+    virtual void flush() {};
 };
 
 /**
@@ -108,6 +183,8 @@ class StdOutLogger : public BaseLogger {
     virtual void log(const std::string &message, const Level level, const std::string &name) override;
     virtual void log(const std::string &message, const Level level) override;
     virtual void log(const std::string &message) override;
+    virtual void log_batch(std::span<const std::string> messages) override;
+    virtual void flush() override;
 };
 
 /**
@@ -120,8 +197,11 @@ class FileLogger : public BaseLogger {
     virtual void log(const std::string &message, const Level level, const std::string &name);
     virtual void log(const std::string &message, const Level level) override;
     virtual void log(const std::string &message);
+    virtual void log_batch(std::span<const std::string> messages) override;
+    virtual void flush() override;
 
    protected:
+    void write(const std::string &text);
     void reopen();
     std::string m_file_name;
     std::ofstream m_file;
@@ -139,6 +219,8 @@ class SpdLogger : public BaseLogger {
     virtual void log(const std::string &message, const Level level, const std::string &name);
     virtual void log(const std::string &message, const Level level) override;
     virtual void log(const std::string &message);
+    virtual void log_batch(std::span<const std::string> messages) override;
+    virtual void flush() override;
 
    protected:
     std::string m_file_name;
@@ -198,42 +280,135 @@ inline void log(const std::string &message, const Level level) { get_logger().lo
 // statically log manually without a level
 inline void log(const std::string &message) { get_logger().log(message); }
 
-inline void TRACE(const std::string &message, const std::string &name = "") {
-    if (LEVEL_CUTOFF > Level::TRACE) {
+// statically log a batch of complete log lines with a single write
+inline void log_batch(std::span<const std::string> messages) { get_logger().log_batch(messages); }
+
+inline void flush() { get_logger().flush(); }
+
+/*
+Queues a record with the raw arguments; the message is formatted on the LogProcessor thread. The format string is
+checked against the arguments at compile time.
+
+    Logging::INFOF(m_name, "Read {} bytes from partition {}", bytes, partition);
+*/
+template <typename... Args>
+inline void log_record(const Level level, std::string_view name, fmt::format_string<Args...> format,
+                       const Args &...args) {
+    LogRecord record;
+    record.time = std::chrono::steady_clock::now();
+    record.level = level;
+    fmt::string_view view = format;
+    record.format = std::string_view(view.data(), view.size());
+    record.set_name(name);
+    record.capture(args...);
+    log_queue.enqueue(std::move(record));
+}
+
+template <typename... Args>
+inline void TRACEF(std::string_view name, fmt::format_string<Args...> format, const Args &...args) {
+    if (!enabled(Level::TRACE)) {
         return;
     }
 
-    log_queue.enqueue(create_log(message, Level::TRACE, name));
+    log_record(Level::TRACE, name, format, args...);
 }
 
-inline void DEBUG(const std::string &message, const std::string &name = "") {
-    if (LEVEL_CUTOFF > Level::DEBUG) {
+template <typename... Args>
+inline void DEBUGF(std::string_view name, fmt::format_string<Args...> format, const Args &...args) {
+    if (!enabled(Level::DEBUG)) {
         return;
     }
 
-    log_queue.enqueue(create_log(message, Level::DEBUG, name));
+    log_record(Level::DEBUG, name, format, args...);
 }
 
-inline void INFO(const std::string &message, const std::string &name = "") {
-    // get_logger().log(message, Level::INFO);
-    if (LEVEL_CUTOFF > Level::INFO) {
+template <typename... Args>
+inline void INFOF(std::string_view name, fmt::format_string<Args...> format, const Args &...args) {
+    if (!enabled(Level::INFO)) {
         return;
     }
 
-    log_queue.enqueue(create_log(message, Level::INFO, name));
+    log_record(Level::INFO, name, format, args...);
 }
 
-inline void WARN(const std::string &message, const std::string &name = "") {
-    if (LEVEL_CUTOFF > Level::WARN) {
+template <typename... Args>
+inline void WARNF(std::string_view name, fmt::format_string<Args...> format, const Args &...args) {
+    if (!enabled(Level::WARN)) {
         return;
     }
 
-    log_queue.enqueue(create_log(message, Level::WARN, name));
+    log_record(Level::WARN, name, format, args...);
+}
+
+template <typename... Args>
+inline void ERRORF(std::string_view name, fmt::format_string<Args...> format, const Args &...args) {
+    log_record(Level::ERROR, name, format, args...);
 }
 
+/*
+Decides which calls of a noisy call site get logged: every n-th call, and at most per_second calls per second
+(0 turns either limit off). Calls that are left out by the rate limit are counted, and the count is handed to the
+next call that is logged so that it can report them. Calls that are sampled out are expected and not counted.
+*/
+class LogLimiter {
+   public:
+    LogLimiter(uint32_t every_n, uint32_t per_second) : m_every_n(every_n), m_per_second(per_second) {}
+
+    bool admit(uint64_t &suppressed) {
+        if (m_every_n > 1 && m_calls.fetch_add(1, std::memory_order_relaxed) % m_every_n != 0) {
+            return false;
+        }
+
+        bool pass = true;
+        if (m_per_second) {
+            int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                              std::chrono::steady_clock::now().time_since_epoch())
+                              .count();
+            int64_t window = m_window.load(std::memory_order_relaxed);
+            if (window != now && m_window.compare_exchange_strong(window, now, std::memory_order_relaxed)) {
+                m_in_window.store(0, std::memory_order_relaxed);
+            }
+            pass = m_in_window.fetch_add(1, std::memory_order_relaxed) < m_per_second;
+        }
+
+        if (!pass) {
+            m_suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+   private:
+    const uint32_t m_every_n;
+    const uint32_t m_per_second;
+    std::atomic<uint64_t> m_calls = 0;
+    std::atomic<int64_t> m_window = -1;  // Second the m_in_window count is for
+    std::atomic<uint32_t> m_in_window = 0;
+    std::atomic<uint64_t> m_suppressed = 0;
+};
+
+inline void TRACE(const std::string &message, const std::string &name = "") { TRACEF(name, "{}", message); }
+
+inline void DEBUG(const std::string &message, const std::string &name = "") { DEBUGF(name, "{}", message); }
+
+inline void INFO(const std::string &message, const std::string &name = "") { INFOF(name, "{}", message); }
+
+inline void WARN(const std::string &message, const std::string &name = "") { WARNF(name, "{}", message); }
+
 // TODO: Give LogProccessor priority on ERROR so that we don't miss any errors
-inline void ERROR(const std::string &message, const std::string &name = "") {
-    log_queue.enqueue(create_log(message, Level::ERROR, name));
+inline void ERROR(const std::string &message, const std::string &name = "") { ERRORF(name, "{}", message); }
+
+inline Level parse_level(const std::string &level) {
+    static const std::unordered_map<std::string, Level> levels{{"trace", Level::TRACE}, {"debug", Level::DEBUG},
+                                                               {"info", Level::INFO},   {"warn", Level::WARN},
+                                                               {"error", Level::ERROR}};
+    auto found = levels.find(level);
+    if (found == levels.end()) {
+        WARN("Unknown log level '" + level + "', using 'info'", "Logging");
+        return Level::INFO;
+    }
+    return found->second;
 }
 
 /**
@@ -242,15 +417,17 @@ inline void ERROR(const std::string &message, const std::string &name = "") {
  **/
 class LogProcessor {
    private:
-    bool m_should_run;
+    std::atomic<bool> m_should_run;
     std::unique_ptr<std::thread> m_t;
     std::atomic<size_t> *m_active_processors;
     std::condition_variable *m_log_cv;
     std::mutex *m_log_cv_mutex;
     void run();
+    void write_batch(std::vector<LogRecord> &batch, std::vector<std::string> &lines, LogFormatter &formatter);
 
    public:
-    LogProcessor(std::atomic<size_t> *active_processors, std::condition_variable *log_cv, std::mutex *log_cv_mutex);
+    LogProcessor(std::atomic<size_t> *active_processors, std::condition_variable *log_cv, std::mutex *log_cv_mutex,
+                 const Config &config = {});
     ~LogProcessor();
     bool start();
     void join() const;
@@ -258,4 +435,54 @@ class LogProcessor {
 };
 
 }  // namespace Logging
+
+/*
+Log entry points that cost nothing when their level is off. Calls below LEVEL_CUTOFF are compiled out, and for the
+others the runtime level is checked before any of the arguments is evaluated.
+
+    LOG_DEBUG(m_name, "Decoded {} fields", record.fields.size());
+*/
+#define LOG_AT(level, name, ...)                                   \
+    do {                                                           \
+        if constexpr ((level) >= Logging::LEVEL_CUTOFF) {          \
+            if (Logging::enabled(level)) {                         \
+                Logging::log_record((level), (name), __VA_ARGS__); \
+            }                                                      \
+        }                                                          \
+    } while (0)
+
+#define LOG_TRACE(name, ...) LOG_AT(Logging::Level::TRACE, name, __VA_ARGS__)
+#define LOG_DEBUG(name, ...) LOG_AT(Logging::Level::DEBUG, name, __VA_ARGS__)
+#define LOG_INFO(name, ...) LOG_AT(Logging::Level::INFO, name, __VA_ARGS__)
+#define LOG_WARN(name, ...) LOG_AT(Logging::Level::WARN, name, __VA_ARGS__)
+#define LOG_ERROR(name, ...) LOG_AT(Logging::Level::ERROR, name, __VA_ARGS__)
+
+/*
+Rate limited and sampled variants for call sites that fire per message. The limits are kept per call site. When a
+call gets through after others were left out by the rate limit, it is preceded by a line that says how many were
+suppressed, so errors are never dropped silently.
+
+    LOG_EVERY_N(INFO, m_name, 1000, "Read {} bytes", bytes);       // 1st, 1001st, 2001st, ... call
+    LOG_PER_SECOND(ERROR, m_name, 10, "Consume failed: {}", err);  // at most 10 lines a second
+*/
+#define LOG_LIMITED_AT(level, name, every_n, per_second, ...)                                               \
+    do {                                                                                                    \
+        if constexpr ((level) >= Logging::LEVEL_CUTOFF) {                                                   \
+            if (Logging::enabled(level)) {                                                                  \
+                static Logging::LogLimiter log_limiter_((every_n), (per_second));                           \
+                uint64_t log_suppressed_ = 0;                                                               \
+                if (log_limiter_.admit(log_suppressed_)) {                                                  \
+                    if (log_suppressed_) {                                                                  \
+                        Logging::log_record((level), (name), "Suppressed {} messages like the next one",    \
+                                            log_suppressed_);                                               \
+                    }                                                                                       \
+                    Logging::log_record((level), (name), __VA_ARGS__);                                      \
+                }                                                                                           \
+            }                                                                                               \
+        }                                                                                                   \
+    } while (0)
+
+#define LOG_EVERY_N(level, name, n, ...) LOG_LIMITED_AT(Logging::Level::level, name, n, 0, __VA_ARGS__)
+#define LOG_PER_SECOND(level, name, k, ...) LOG_LIMITED_AT(Logging::Level::level, name, 0, k, __VA_ARGS__)
+
 #endif
\ No newline at end of file
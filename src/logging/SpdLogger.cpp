@@ -22,16 +22,22 @@ Logging::SpdLogger::SpdLogger(const Config &config) : BaseLogger(config)
         minute = atoi(config.find("minute")->second.c_str());
     }
 
+    // Mirroring every line to stdout costs a second synchronous write and can be turned off
+    bool mirror_stdout = config.find("stdout") == config.end() || config.find("stdout")->second != "false";
+
     std::vector<spdlog::sink_ptr> sinks;
-    sinks.push_back(std::make_shared<spdlog::sinks::stdout_sink_st>());
+    if (mirror_stdout)
+    {
+        sinks.push_back(std::make_shared<spdlog::sinks::stdout_sink_st>());
+    }
     // New file created every day at hour:minute am
     sinks.push_back(std::make_shared<spdlog::sinks::daily_file_sink_mt>(m_file_name, hour, minute));
 
     m_logger = std::make_shared<spdlog::logger>("logger", begin(sinks), end(sinks));
     m_logger->set_level(spdlog::level::trace);
-    m_logger->sinks()[0]->set_pattern("%v");
-    m_logger->sinks()[1]->set_pattern("%v");
-    m_logger->flush_on(spdlog::level::trace);
+    m_logger->set_pattern("%v");
+    // With a flush interval, lines are flushed by flush_due() and flush(); otherwise every line is flushed
+    m_logger->flush_on(m_flush_interval.count() ? spdlog::level::off : spdlog::level::trace);
     spdlog::register_logger(m_logger);
 }
 
@@ -57,4 +63,26 @@ void Logging::SpdLogger::log(const std::string &message, const Level level)
 void Logging::SpdLogger::log(const std::string &message)
 {
     m_logger->trace(message);
+    if (m_flush_interval.count() && flush_due(message.size()))
+    {
+        m_logger->flush();
+    }
+}
+
+void Logging::SpdLogger::log_batch(std::span<const std::string> messages)
+{
+    if (messages.empty())
+    {
+        return;
+    }
+
+    // The sinks terminate the record themselves
+    std::string joined = join(messages);
+    joined.pop_back();
+    log(joined);
+}
+
+void Logging::SpdLogger::flush()
+{
+    m_logger->flush();
 }
\ No newline at end of file
@@ -28,5 +28,24 @@ void Logging::StdOutLogger::log(const std::string &message)
     // obviously we dont care if flushes interleave
     // std::lock_guard<std::mutex> lk{lock};
     std::cout << message;
+    if (flush_due(message.size()))
+    {
+        std::cout.flush();
+    }
+}
+
+void Logging::StdOutLogger::log_batch(std::span<const std::string> messages)
+{
+    // One write for the whole batch, so lines of other writers can not end up in between
+    std::string joined = join(messages);
+    std::cout << joined;
+    if (flush_due(joined.size()))
+    {
+        std::cout.flush();
+    }
+}
+
+void Logging::StdOutLogger::flush()
+{
     std::cout.flush();
 }
\ No newline at end of file
@@ -1,19 +1,30 @@
+#ifdef __APPLE__
 #include <_string.h>
+#include <sys/event.h>  // for kqueue() etc.
+#endif
 #include <librdkafka/rdkafkacpp.h>
 #include <signal.h>
-#include <sys/event.h>  // for kqueue() etc.
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <future>  // for async()
 #include <iostream>
 #include <map>
 #include <string>
+#include <vector>
 
+#include "BatchTuner.h"
 #include "Database.h"
+#ifdef __linux__
+#include "EventLoopConsumer.h"
+#endif
+#include "GroupConsumer.h"
 #include "KafkaConsumerCallback.h"
 #include "KafkaPoller.h"
+#include "PartitionConsumer.h"
 #include "SignalChannel.h"
 #include "config/ConfigParser.h"
 #include "logging/Logging.h"
@@ -33,21 +44,18 @@ std::shared_ptr<SignalChannel> listen_for_sigint(sigset_t &sigset) {
     sigaddset(&sigset, SIGTERM);
     pthread_sigmask(SIG_BLOCK, &sigset, nullptr);
 
-    std::thread signal_handler{[&sig_channel, &sigset]() {
+    std::thread signal_handler{[sig_channel, &sigset]() {
         int signum = 0;
 
         // wait untl a signal is delivered
         sigwait(&sigset, &signum);
-        sig_channel->m_shutdown_requested.store(true);
-
-        // notify all waiting workers to check their predicate
-        sig_channel->m_cv.notify_all();
+        sig_channel->request_shutdown();
         std::cout << "Received signal " << signum << "\n";
         return signum;
     }};
     signal_handler.detach();
 #elif __APPLE__
-    std::thread signal_handler{[&sig_channel]() {
+    std::thread signal_handler{[sig_channel]() {
         int kq = kqueue();
 
         /* Two kevent structs */
@@ -73,8 +81,7 @@ std::shared_ptr<SignalChannel> listen_for_sigint(sigset_t &sigset) {
         switch (ke->filter) {
             case EVFILT_SIGNAL:
                 std::cout << "Received signal " << strsignal(ke->ident) << "\n";
-                sig_channel->m_shutdown_requested.store(true);
-                sig_channel->m_cv.notify_all();
+                sig_channel->request_shutdown();
                 break;
             default:
                 break;
@@ -160,33 +167,55 @@ int main(int argc, char *argv[]) {
     sigset_t sigset;
     std::shared_ptr<SignalChannel> sig_channel = listen_for_sigint(sigset);
 
+    /*************************************************************************
+     *
+     * CONFIGURATION
+     *
+     *************************************************************************/
+    ConfigParser &config = ConfigParser::instance(config_file);
+
     /*************************************************************************
      *
      * LOGGER
      *
      *************************************************************************/
+    std::map<std::string, std::string> logging_config = config.logging();
+    if (logging_config.count("level")) {
+        Logging::set_level(Logging::parse_level(logging_config["level"]));
+    }
+
     std::atomic<size_t> active_processors = 0;
     std::condition_variable log_cv;
     std::mutex log_cv_mutex;
-    Logging::LogProcessor log_processor(&active_processors, &log_cv, &log_cv_mutex);
+    Logging::LogProcessor log_processor(&active_processors, &log_cv, &log_cv_mutex,
+                                        Logging::Config(logging_config.begin(), logging_config.end()));
 
     log_processor.start();
 
-    /*************************************************************************
-     *
-     * CONFIGURATION
-     *
-     *************************************************************************/
-    ConfigParser &config = ConfigParser::instance(config_file);
-
     /*************************************************************************
      *
      * DATABASE
      *
      *************************************************************************/
-    Logging::INFO("Connecting to database...", name);
-    Database::init("hostaddr=127.0.0.1 port=5432 dbname=odynet user=postgres password=example");
-    Logging::INFO("Connected to database", name);
+    std::vector<std::map<std::string, std::string>> sink_configs = config.sinks();
+    bool database_enabled = std::any_of(sink_configs.begin(), sink_configs.end(),
+                                        [](auto &sink_config) { return sink_config["type"] == "database"; });
+    std::map<std::string, std::string> database_config = config.database();
+    if (database_enabled) {
+        if (database_config["dsn"].empty()) {
+            Logging::ERROR("No 'dsn' configured for the database", name);
+            exit(1);
+        }
+        size_t pool_size = database_config.count("pool_size") ? std::stoul(database_config["pool_size"]) : 4;
+        size_t cache_capacity =
+            database_config.count("cache_capacity") ? std::stoul(database_config["cache_capacity"]) : 100000;
+
+        Logging::INFO("Connecting to database with " + std::to_string(pool_size) + " connections...", name);
+        Database::init(database_config["dsn"], pool_size, cache_capacity);
+        Logging::INFO("Connected to database, cached " + std::to_string(Database::instance().object_ids().size()) +
+                          " object ids",
+                      name);
+    }
 
     /*************************************************************************
      *
@@ -198,72 +227,280 @@ int main(int argc, char *argv[]) {
 
     RdKafka::Conf *conf = RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL);
     std::string errstr;
-    if (conf->set("bootstrap.servers", kafka_config["bootstrap.servers"], errstr) != RdKafka::Conf::CONF_OK) {
-        Logging::ERROR(errstr, name);
-        kill(getpid(), SIGINT);
+    conf->set("enable.partition.eof", "true", errstr);
+
+    /*
+     * With a group.id the type_map topics are consumed as a member of that consumer group, starting from the
+     * committed offsets. Without one, every partition of every topic is consumed from the beginning.
+     */
+    bool group_mode = kafka_config.count("group.id") && !kafka_config["group.id"].empty();
+    if (group_mode) {
+        kafka_config.emplace("auto.offset.reset", "earliest");
     }
-    if (conf->set("client.id", kafka_config["client.id"], errstr) != RdKafka::Conf::CONF_OK) {
-        Logging::ERROR(errstr, name);
-        kill(getpid(), SIGINT);
+
+    /*
+     * Consumers hand off batches sized by the BatchTuner. With consume.adaptive it tunes them towards
+     * consume.target.latency.ms from librdkafka's statistics, and fetch settings that are not configured are derived
+     * from the target.
+     */
+    size_t batch_size =
+        kafka_config.count("consume.batch.size") ? std::stoul(kafka_config["consume.batch.size"]) : 1000;
+    int linger_ms =
+        kafka_config.count("consume.batch.linger.ms") ? std::stoi(kafka_config["consume.batch.linger.ms"]) : 10;
+    auto batch_tuner = std::make_shared<BatchTuner>(batch_size, linger_ms);
+    if (kafka_config.count("consume.adaptive") && kafka_config["consume.adaptive"] == "true") {
+        int target_latency_ms = kafka_config.count("consume.target.latency.ms")
+                                    ? std::stoi(kafka_config["consume.target.latency.ms"])
+                                    : 100;
+        size_t min_batch_size =
+            kafka_config.count("consume.batch.size.min") ? std::stoul(kafka_config["consume.batch.size.min"]) : 1;
+        size_t max_batch_size = kafka_config.count("consume.batch.size.max")
+                                    ? std::stoul(kafka_config["consume.batch.size.max"])
+                                    : 10 * batch_size;
+        batch_tuner->enable(target_latency_ms, min_batch_size, max_batch_size);
+
+        for (const auto &[key, value] : BatchTuner::fetch_defaults(target_latency_ms)) {
+            kafka_config.emplace(key, value);
+        }
+        kafka_config.emplace("statistics.interval.ms", "1000");
+        if (conf->set("event_cb", batch_tuner.get(), errstr) != RdKafka::Conf::CONF_OK) {
+            Logging::ERROR(errstr, name);
+            exit(1);
+        }
     }
 
-    conf->set("enable.partition.eof", "true", errstr);
+    /*
+     * Every other key of the kafka section is handed to librdkafka as is. The schema registry URL and the consume.*
+     * keys configure this application.
+     */
+    for (const auto &[key, value] : kafka_config) {
+        if (key == "schema.registry.url" || key.rfind("consume.", 0) == 0) {
+            continue;
+        }
+        if (conf->set(key, value, errstr) != RdKafka::Conf::CONF_OK) {
+            Logging::ERROR("Invalid Kafka configuration '" + key + "': " + errstr, name);
+            exit(1);
+        }
+    }
 
-    // Create a consumer handle
-    RdKafka::Consumer *consumer = RdKafka::Consumer::create(conf, errstr);
-    if (!consumer) {
-        Logging::ERROR("Failed to create consumer: " + errstr, name);
-        exit(1);
+    /*
+     * Decode stage. The consumers only hand off messages to it. In group mode it reports the offsets of the
+     * messages its sinks have written durably to the GroupConsumer.
+     */
+    std::unique_ptr<GroupConsumer> group_consumer;
+#ifdef __linux__
+    std::unique_ptr<EventLoopConsumer> event_loop;
+#endif
+    OffsetCallback on_durable;
+    if (group_mode) {
+        on_durable = [&group_consumer](const PartitionOffsets &offsets) { group_consumer->store_offsets(offsets); };
     }
-    Logging::INFO("Created consumer " + consumer->name(), name);
 
-    RdKafka::Conf *tconf = RdKafka::Conf::create(RdKafka::Conf::CONF_TOPIC);
-    std::string topic_str = "spo";
-    RdKafka::Topic *topic = RdKafka::Topic::create(consumer, topic_str, tconf, errstr);
-    if (!topic) {
-        Logging::ERROR("Failed to create topic: " + errstr, name);
+    std::map<std::string, std::string> decode_config = config.decode();
+    std::map<std::string, DecodeMode> topic_modes;
+    for (const auto &[key, value] : decode_config) {
+        if (key.rfind("mode.", 0) == 0) {
+            topic_modes.emplace(key.substr(5), KafkaConsumerCallback::parse_decode_mode(value));
+        }
+    }
+    DecodePool decode_pool(decode_config.count("workers") ? std::stoul(decode_config["workers"]) : 0,
+                           KafkaConsumerCallback::parse_decode_mode(decode_config["mode"]), sink_configs, topic_modes,
+                           on_durable);
+    size_t high_watermark =
+        decode_config.count("high_watermark") ? std::stoul(decode_config["high_watermark"]) : 100000;
+    size_t low_watermark =
+        decode_config.count("low_watermark") ? std::stoul(decode_config["low_watermark"]) : high_watermark / 2;
+    decode_pool.set_watermarks(high_watermark, low_watermark);
+    int shutdown_timeout_ms =
+        decode_config.count("shutdown_timeout_ms") ? std::stoi(decode_config["shutdown_timeout_ms"]) : 30000;
+#ifdef __linux__
+    decode_pool.set_relieved_callback([&event_loop]() {
+        if (event_loop) {
+            event_loop->relieved();
+        }
+    });
+#endif
+    if (!decode_pool.start()) {
         exit(1);
     }
 
-    Logging::INFO("Starting the consumer handle", name);
-    int64_t start_offset = RdKafka::Topic::OFFSET_BEGINNING;  // RdKafka::Topic::OFFSET_STORED
-    int32_t partition = 0;
-    RdKafka::ErrorCode resp = consumer->start(topic, partition, start_offset);
-    if (resp != RdKafka::ERR_NO_ERROR) {
-        Logging::ERROR("Failed to start consumer: " + RdKafka::err2str(resp), name);
-        exit(1);
+    RdKafka::Consumer *consumer = nullptr;
+    std::vector<RdKafka::Topic *> topics;
+    std::vector<std::unique_ptr<PartitionConsumer>> partition_consumers;
+    bool use_event_loop = false;
+    if (group_mode) {
+        /*
+         * Start a GroupConsumer subscribed to every topic in the type_map
+         */
+        int commit_interval_ms = kafka_config.count("consume.commit.interval.ms")
+                                     ? std::stoi(kafka_config["consume.commit.interval.ms"])
+                                     : 5000;
+        group_consumer = std::make_unique<GroupConsumer>(decode_pool, sig_channel, batch_tuner, commit_interval_ms,
+                                                         shutdown_timeout_ms);
+        if (!group_consumer->create(conf, errstr)) {
+            Logging::ERROR("Failed to create consumer: " + errstr, name);
+            exit(1);
+        }
+
+        std::vector<std::string> topic_names;
+        for (const auto &[topic_str, schema_config] : schemas) {
+            topic_names.push_back(topic_str);
+        }
+        if (!group_consumer->start(topic_names)) {
+            exit(1);
+        }
+    } else {
+        // Create a consumer handle
+        consumer = RdKafka::Consumer::create(conf, errstr);
+        if (!consumer) {
+            Logging::ERROR("Failed to create consumer: " + errstr, name);
+            exit(1);
+        }
+        Logging::INFO("Created consumer " + consumer->name(), name);
+
+        /*
+         * Consume every partition of every topic in the type_map, either on a single thread woken up by epoll
+         * (consume.event_loop, the default on Linux) or with one PartitionConsumer per partition
+         */
+#ifdef __linux__
+        use_event_loop = !kafka_config.count("consume.event_loop") || kafka_config["consume.event_loop"] == "true";
+        if (use_event_loop) {
+            event_loop = std::make_unique<EventLoopConsumer>(consumer, decode_pool, sig_channel, batch_tuner);
+        }
+#endif
+        size_t consumed_partitions = 0;
+        int64_t start_offset = RdKafka::Topic::OFFSET_BEGINNING;  // RdKafka::Topic::OFFSET_STORED
+        for (const auto &[topic_str, schema_config] : schemas) {
+            RdKafka::Conf *tconf = RdKafka::Conf::create(RdKafka::Conf::CONF_TOPIC);
+            RdKafka::Topic *topic = RdKafka::Topic::create(consumer, topic_str, tconf, errstr);
+            delete tconf;
+            if (!topic) {
+                Logging::ERROR("Failed to create topic: " + errstr, name);
+                exit(1);
+            }
+            topics.push_back(topic);
+
+            std::vector<int32_t> partitions = PartitionConsumer::partitions_for(consumer, topic, errstr);
+            if (partitions.empty()) {
+                Logging::ERROR("No partitions found for topic '" + topic_str + "': " + errstr, name);
+                exit(1);
+            }
+            Logging::INFO(
+                "Discovered " + std::to_string(partitions.size()) + " partitions for topic '" + topic_str + "'", name);
+
+            consumed_partitions += partitions.size();
+            for (int32_t partition : partitions) {
+#ifdef __linux__
+                if (event_loop) {
+                    if (!event_loop->add(topic, partition, start_offset)) {
+                        exit(1);
+                    }
+                    continue;
+                }
+#endif
+                partition_consumers.emplace_back(std::make_unique<PartitionConsumer>(
+                    consumer, topic, partition, decode_pool, sig_channel, batch_tuner));
+            }
+        }
+
+        // Every partition hands off batches of its own, while the GroupConsumer batches all of its partitions
+        batch_tuner->set_consumers(consumed_partitions);
+
+        Logging::INFO("Starting the consumer handle", name);
+#ifdef __linux__
+        if (event_loop && !event_loop->start()) {
+            exit(1);
+        }
+#endif
+        for (auto &partition_consumer : partition_consumers) {
+            if (!partition_consumer->start(start_offset)) {
+                exit(1);
+            }
+        }
     }
 
-    KafkaConsumerCallback consumer_cb;
     /*
-     * Consume messages
-     * https://github.com/confluentinc/librdkafka/blob/master/examples/rdkafka_example.cpp
+     * Serve callbacks on the main thread until a shutdown is requested. The GroupConsumer and the event loop serve
+     * their own.
      */
-    int use_ccb = 0;
-    size_t errors = 0;
-    while (1) {
-        if (use_ccb) {
-            consumer->consume_callback(topic, partition, 1000, &consumer_cb, &use_ccb);
+    std::chrono::milliseconds stats_interval(
+        decode_config.count("stats_interval_ms") ? std::stol(decode_config["stats_interval_ms"]) : 10000);
+    auto last_stats = std::chrono::steady_clock::now();
+    while (!sig_channel->m_shutdown_requested.load()) {
+        if (stats_interval.count() && std::chrono::steady_clock::now() - last_stats >= stats_interval) {
+            decode_pool.log_queue_depths();
+            last_stats = std::chrono::steady_clock::now();
+        }
+        batch_tuner->tune(decode_pool.processed());
+        if (consumer && !use_event_loop) {
+            consumer->poll(1000);
         } else {
-            RdKafka::Message *msg = consumer->consume(topic, partition, 1000);
-            if (!consumer_cb.consume_message(msg)) {
-                ++errors;
-                Logging::ERROR("Number of failed deserializations: " + std::to_string(errors), name);
-            }
-            delete msg;
+            std::unique_lock shutdown_lock(sig_channel->m_cv_mutex);
+            sig_channel->m_cv.wait_for(shutdown_lock, std::chrono::milliseconds(1000),
+                                       [&sig_channel]() { return sig_channel->m_shutdown_requested.load(); });
         }
-        consumer->poll(0);
     }
 
     /*
-     * Stop consumer
+     * Stop fetching, then drain what has been dispatched into the sinks and, in group mode, commit the offsets of
+     * what they have written, all within decode.shutdown_timeout_ms. Whatever is not written by then is abandoned
+     * uncommitted, so it is consumed again after a restart rather than lost. Decode workers that are still stuck in
+     * a sink a second later, e.g. in an insert on a dead connection, are left behind and the process exits without
+     * them.
      */
-    consumer->stop(topic, partition);
+    auto shutdown_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(shutdown_timeout_ms);
+    Logging::INFO("Shutting down within " + std::to_string(shutdown_timeout_ms) + " ms", name);
+    for (auto &partition_consumer : partition_consumers) {
+        partition_consumer->join();
+    }
+    partition_consumers.clear();
+#ifdef __linux__
+    if (event_loop) {
+        event_loop->join();
+    }
+#endif
 
-    consumer->poll(1000);
+    // Leaving the group drains the decode workers of its partitions, so it has to happen before they are stopped
+    if (group_consumer) {
+        group_consumer->join();
+    }
+
+    if (!decode_pool.stop(shutdown_deadline)) {
+        Logging::ERROR("Could not drain the decode stage in time", name);
+    }
+    if (!decode_pool.join(shutdown_deadline + std::chrono::seconds(1))) {
+        Logging::ERROR("Decode workers are still writing past the deadline, exiting without them", name);
+        log_processor.stop();
+        log_processor.join();
+        std::_Exit(EXIT_FAILURE);
+    }
+
+    if (database_enabled) {
+        const ObjectIdCache &object_ids = Database::instance().object_ids();
+        Logging::INFO("Object id cache: " + std::to_string(object_ids.hits()) + " hits, " +
+                          std::to_string(object_ids.misses()) + " misses, " + std::to_string(object_ids.size()) +
+                          " of " + std::to_string(object_ids.capacity()) + " entries used",
+                      name);
+    }
 
-    delete topic;
+    if (consumer) {
+        consumer->poll(1000);
+    }
+
+#ifdef __linux__
+    // The decode workers may signal the event loop until they have been joined, and its queues go before the handle
+    event_loop.reset();
+#endif
+    for (RdKafka::Topic *topic : topics) {
+        delete topic;
+    }
     delete consumer;
+    group_consumer.reset();
+
+    // Write out whatever is still queued for the loggers
+    Logging::INFO("Shut down", name);
+    log_processor.stop();
+    log_processor.join();
 
     return 0;
 }
\ No newline at end of file
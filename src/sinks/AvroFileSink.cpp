@@ -0,0 +1,170 @@
+#include "AvroFileSink.h"
+
+#include <algorithm>
+#include <avro/Exception.hh>
+#include <filesystem>
+#include <stdexcept>
+
+#include "SchemaRegistry.h"
+#include "logging/Logging.h"
+
+AvroFileSink::AvroFileSink(const std::string &name, size_t worker, SinkConfig config)
+    : m_name(name), m_worker(worker), m_config(config) {
+    if (config["path"].empty()) {
+        throw std::runtime_error("File based sinks require a 'path'");
+    }
+    if (config.count("block_bytes")) {
+        m_block_bytes = std::max<size_t>(1, std::stoul(config["block_bytes"]));
+    }
+    if (config.count("codec")) {
+        m_codec = parse_codec(config["codec"]);
+    }
+}
+
+avro::Codec AvroFileSink::parse_codec(const std::string &codec) {
+    if (codec == "null") {
+        return avro::NULL_CODEC;
+    }
+    if (codec == "deflate") {
+        return avro::DEFLATE_CODEC;
+    }
+#ifdef SNAPPY_CODEC_AVAILABLE
+    if (codec == "snappy") {
+        return avro::SNAPPY_CODEC;
+    }
+#endif
+#ifdef ZSTD_CODEC_AVAILABLE
+    if (codec == "zstd") {
+        return avro::ZSTD_CODEC;
+    }
+#endif
+    throw std::runtime_error("Codec '" + codec + "' is unknown or not available in this build of Avro");
+}
+
+AvroFileSink::Output *AvroFileSink::output_for(int32_t writer_id, std::string &errstr) {
+    auto found = m_outputs.find(writer_id);
+    if (found != m_outputs.end()) {
+        return found->second.get();
+    }
+
+    std::shared_ptr<const avro::ValidSchema> schema = SchemaRegistry::instance().schema_for_id(writer_id, errstr);
+    if (!schema) {
+        return nullptr;
+    }
+
+    SinkConfig config = m_config;
+    config["path"] += "-" + std::to_string(writer_id);
+    auto output = std::unique_ptr<Output>(new Output{FileRoller(config, m_worker, ".avro"), std::move(schema)});
+    return m_outputs.emplace(writer_id, std::move(output)).first->second.get();
+}
+
+bool AvroFileSink::open(Output &output, std::string &errstr) {
+    output.file_name = output.roller.next();
+    try {
+        output.writer = std::make_unique<avro::DataFileWriterBase>(output.file_name.c_str(), *output.schema,
+                                                                   m_block_bytes, m_codec);
+    } catch (const avro::Exception &e) {
+        errstr = "Could not open '" + output.file_name + "': " + e.what();
+        return false;
+    }
+    Logging::INFO("Writing to '" + output.file_name + "'", m_name);
+    return true;
+}
+
+/*
+Writes the open block and the file's last sync marker
+*/
+bool AvroFileSink::close(Output &output) {
+    if (!output.writer) {
+        return true;
+    }
+    bool closed = true;
+    try {
+        output.writer->close();
+    } catch (const avro::Exception &e) {
+        LOG_ERROR(m_name, "Could not close '{}': {}", output.file_name, e.what());
+        closed = false;
+    }
+    output.writer.reset();
+    return closed;
+}
+
+/*
+Copies the payload behind the CP1 framing into the current block. The writer starts a new block before the record
+once the current one holds block_bytes.
+*/
+void AvroFileSink::write(const SinkRecord &record) {
+    std::string errstr;
+    Output *output = output_for(record.writer_id, errstr);
+    if (!output || (!output->writer && !open(*output, errstr))) {
+        ++m_errors;
+        m_failed = true;
+        LOG_PER_SECOND(ERROR, m_name, 10, "Could not write record at offset {}: {}", record.message->offset(), errstr);
+        return;
+    }
+
+    const uint8_t *payload =
+        static_cast<const uint8_t *>(record.message->payload()) + SchemaRegistry::CP1_FRAMING_SIZE;
+    try {
+        output->writer->syncIfNeeded();
+        output->writer->encoder().writeFixed(payload, record.message->len() - SchemaRegistry::CP1_FRAMING_SIZE);
+        output->writer->incr();
+    } catch (const avro::Exception &e) {
+        ++m_errors;
+        m_failed = true;
+        LOG_ERROR(m_name, "Could not write to '{}' ({} errors in total): {}", output->file_name, m_errors, e.what());
+        close(*output);
+    }
+}
+
+/*
+Blocks are left open across batches, so that a batch does not end up as a block of its own. Once one file is due to
+be rolled, every file is closed, which writes their open blocks, so that the sink holds nothing afterwards and the
+worker can commit what it has written. Also fails if some record could not be written since the last flush.
+*/
+bool AvroFileSink::flush() {
+    bool due = std::any_of(m_outputs.begin(), m_outputs.end(), [](const auto &output) {
+        if (!output.second->writer) {
+            return false;
+        }
+        std::error_code ec;
+        uintmax_t bytes = std::filesystem::file_size(output.second->file_name, ec);
+        return output.second->roller.due(ec ? 0 : bytes);
+    });
+    if (due) {
+        return sync();
+    }
+
+    bool written = !m_failed;
+    m_failed = false;
+    return written;
+}
+
+/*
+The open block of a file is only written when the block is full or the file is closed
+*/
+bool AvroFileSink::holds_records() const {
+    return std::any_of(m_outputs.begin(), m_outputs.end(),
+                       [](const auto &output) { return output.second->writer != nullptr; });
+}
+
+bool AvroFileSink::sync() {
+    bool written = !m_failed;
+    m_failed = false;
+    for (auto &[writer_id, output] : m_outputs) {
+        written = close(*output) && written;
+    }
+    return written;
+}
+
+bool AvroFileSink::needs_json() const { return false; }
+
+AvroFileSink::~AvroFileSink() {
+    bool written = !m_failed;
+    for (auto &[writer_id, output] : m_outputs) {
+        written = close(*output) && written;
+    }
+    if (!written) {
+        LOG_ERROR(m_name, "Could not write every record before shutting down ({} errors in total)", m_errors);
+    }
+}
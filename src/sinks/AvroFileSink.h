@@ -0,0 +1,62 @@
+/**
+ * Writes the binary Avro payloads of records into Avro object container files, without decoding them.
+ *
+ * Every writer schema gets files of its own, named <path>-<schema id>-<worker>-<UTC timestamp>-<sequence>.avro and
+ * rolled like the other file based sinks (see FileRoller). The payload behind the CP1 framing is already the binary
+ * encoding of a record of the file's schema, so it is copied into the current block as is. Blocks are compressed
+ * with codec (null, deflate, or snappy and zstd when the build enables them; default deflate) once they hold
+ * block_bytes (default 64 KiB), and the block that is still open when a file is rolled or the sink is destroyed is
+ * written then.
+ **/
+#ifndef AVRO_FILE_SINK_H
+#define AVRO_FILE_SINK_H
+
+#include <avro/DataFile.hh>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "FileRoller.h"
+#include "Sink.h"
+
+class AvroFileSink : public Sink {
+   public:
+    AvroFileSink(const std::string &name, size_t worker, SinkConfig config);
+    AvroFileSink(const AvroFileSink &) = delete;
+    void operator=(const AvroFileSink &) = delete;
+    void write(const SinkRecord &record) override;
+    bool flush() override;
+    bool holds_records() const override;
+    bool sync() override;
+    bool needs_json() const override;
+    ~AvroFileSink();
+
+   private:
+    static constexpr size_t DEFAULT_BLOCK_BYTES = 64 << 10;
+
+    /*
+    The open file of one writer schema
+    */
+    struct Output {
+        FileRoller roller;
+        std::shared_ptr<const avro::ValidSchema> schema;
+        std::unique_ptr<avro::DataFileWriterBase> writer;
+        std::string file_name;
+    };
+
+    const std::string m_name;
+    const size_t m_worker;
+    SinkConfig m_config;
+    size_t m_block_bytes = DEFAULT_BLOCK_BYTES;
+    avro::Codec m_codec = avro::DEFLATE_CODEC;
+    std::unordered_map<int32_t, std::unique_ptr<Output>> m_outputs;
+    size_t m_errors = 0;
+    bool m_failed = false;  // Some record could not be written since the last flush() or sync()
+
+    static avro::Codec parse_codec(const std::string &codec);
+    Output *output_for(int32_t writer_id, std::string &errstr);
+    bool open(Output &output, std::string &errstr);
+    bool close(Output &output);
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "DatabaseSink.h"
+
+#include <cpprest/http_client.h>  // web::json::value
+
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+#include "logging/Logging.h"
+
+DatabaseSink::DatabaseSink(const std::string &name, SinkConfig config) : m_name(name) {
+    if (config.count("batch_size")) {
+        m_batch_size = std::max<size_t>(1, std::stoul(config["batch_size"]));
+    }
+    if (config.count("object_type")) {
+        m_object_type = config["object_type"];
+    }
+    m_triples.resize(m_batch_size);
+}
+
+/*
+Records decoded with a plan are read from the flat record, everything else from its JSON
+*/
+void DatabaseSink::write(const SinkRecord &record) {
+    if (record.flat && record.flat->plan) {
+        const FieldValue *subject = record.flat->field("subject");
+        const FieldValue *predicate = record.flat->field("predicate");
+        const FieldValue *object = record.flat->field("object");
+        if (!subject || !predicate || !object) {
+            LOG_PER_SECOND(ERROR, m_name, 10, "Record has no subject, predicate and object to persist");
+            return;
+        }
+        add(subject->s, predicate->s, object->s);
+        return;
+    }
+
+    try {
+        web::json::value json_value = web::json::value::parse(std::string(record.json));
+        add(json_value["subject"].as_string(), json_value["predicate"].as_string(), json_value["object"].as_string());
+    } catch (const std::exception &e) {
+        LOG_PER_SECOND(ERROR, m_name, 10, "Could not read triple from record: {}", e.what());
+    }
+}
+
+void DatabaseSink::add(std::string_view subject, std::string_view predicate, std::string_view object) {
+    Triple &triple = m_triples[m_count++];
+    triple.subject.assign(subject);
+    triple.predicate.assign(predicate);
+    triple.object.assign(object);
+
+    if (m_count == m_batch_size && !write_batch()) {
+        m_failed = true;
+    }
+}
+
+/*
+Also fails if a batch that add() wrote since the last flush could not be written
+*/
+bool DatabaseSink::flush() {
+    bool persisted = write_batch() && !m_failed;
+    m_failed = false;
+    return persisted;
+}
+
+/*
+Writes the buffered triples in one transaction. The batch is dropped if that fails, so that a database outage does
+not grow the buffer without bound.
+*/
+bool DatabaseSink::write_batch() {
+    if (m_count == 0) {
+        return true;
+    }
+
+    // Every decode worker has a sink of its own, so the shared result of std::localtime() is off limits
+    std::time_t t = std::time(nullptr);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    std::ostringstream oss;
+    oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
+
+    bool persisted = Database::instance().insert_triples(m_triples, m_count, m_object_type, oss.str());
+    if (!persisted) {
+        m_errors += m_count;
+        LOG_ERROR(m_name, "Could not persist {} triples ({} in total)", m_count, m_errors);
+    }
+    m_count = 0;
+    return persisted;
+}
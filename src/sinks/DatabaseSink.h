@@ -0,0 +1,42 @@
+/**
+ * Buffers subject-predicate-object triples of decoded records and persists them in batches.
+ *
+ * The triple of a record is read from its decoded fields when it was decoded with a DecodePlan, otherwise from its
+ * JSON. Every batch_size triples (default 1000), and whenever the sink is flushed, the buffered triples are
+ * written with Database::insert_triples, which copies the whole batch into the database and inserts objects and
+ * relationships with one statement each. Buffered triples are reused across batches so their strings keep their
+ * capacity.
+ **/
+#ifndef DATABASE_SINK_H
+#define DATABASE_SINK_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Database.h"
+#include "Sink.h"
+
+class DatabaseSink : public Sink {
+   public:
+    DatabaseSink(const std::string &name, SinkConfig config);
+    DatabaseSink(const DatabaseSink &) = delete;
+    void operator=(const DatabaseSink &) = delete;
+    void write(const SinkRecord &record) override;
+    bool flush() override;
+
+   private:
+    static constexpr size_t DEFAULT_BATCH_SIZE = 1000;
+
+    const std::string m_name;
+    size_t m_batch_size = DEFAULT_BATCH_SIZE;
+    std::string m_object_type = "MyObjectType";
+    std::vector<Triple> m_triples;
+    size_t m_count = 0;
+    size_t m_errors = 0;
+    bool m_failed = false;  // A batch flushed by add() could not be written since the last flush()
+    void add(std::string_view subject, std::string_view predicate, std::string_view object);
+    bool write_batch();
+};
+
+#endif
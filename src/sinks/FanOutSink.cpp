@@ -0,0 +1,45 @@
+#include "FanOutSink.h"
+
+#include <algorithm>
+
+FanOutSink::FanOutSink(std::vector<std::unique_ptr<Sink>> sinks) : m_sinks(std::move(sinks)) {}
+
+void FanOutSink::write(const SinkRecord &record) {
+    for (auto &sink : m_sinks) {
+        sink->write(record);
+    }
+}
+
+/*
+Every sink is flushed, even if an earlier one failed. Once one sink has written out what it held, the others are
+synced as well, so that the sinks do not take turns holding records and their offsets can be committed.
+*/
+bool FanOutSink::flush() {
+    bool flushed = true;
+    bool rolled = false;
+    for (auto &sink : m_sinks) {
+        bool held = sink->holds_records();
+        flushed = sink->flush() && flushed;
+        rolled = rolled || (held && !sink->holds_records());
+    }
+    if (rolled && holds_records()) {
+        flushed = sync() && flushed;
+    }
+    return flushed;
+}
+
+bool FanOutSink::holds_records() const {
+    return std::any_of(m_sinks.begin(), m_sinks.end(), [](const auto &sink) { return sink->holds_records(); });
+}
+
+bool FanOutSink::sync() {
+    bool synced = true;
+    for (auto &sink : m_sinks) {
+        synced = sink->sync() && synced;
+    }
+    return synced;
+}
+
+bool FanOutSink::needs_json() const {
+    return std::any_of(m_sinks.begin(), m_sinks.end(), [](const auto &sink) { return sink->needs_json(); });
+}
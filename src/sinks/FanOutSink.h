@@ -0,0 +1,25 @@
+/**
+ * Writes every record to several sinks.
+ **/
+#ifndef FAN_OUT_SINK_H
+#define FAN_OUT_SINK_H
+
+#include <memory>
+#include <vector>
+
+#include "Sink.h"
+
+class FanOutSink : public Sink {
+   public:
+    FanOutSink(std::vector<std::unique_ptr<Sink>> sinks);
+    void write(const SinkRecord &record) override;
+    bool flush() override;
+    bool holds_records() const override;
+    bool sync() override;
+    bool needs_json() const override;
+
+   private:
+    std::vector<std::unique_ptr<Sink>> m_sinks;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "FileRoller.h"
+
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+FileRoller::FileRoller(SinkConfig config, size_t worker, const std::string &extension)
+    : m_worker(worker), m_extension(extension) {
+    if (config["path"].empty()) {
+        throw std::runtime_error("File based sinks require a 'path'");
+    }
+    m_path = config["path"];
+    if (config.count("max_bytes")) {
+        m_max_bytes = std::stoull(config["max_bytes"]);
+    }
+    if (config.count("max_age_s")) {
+        m_max_age = std::chrono::seconds(std::stol(config["max_age_s"]));
+    }
+}
+
+/*
+Name of the next file. Creates its directory and starts the clock for max_age_s.
+*/
+std::string FileRoller::next() {
+    auto t = std::time(nullptr);
+    std::tm gmt{};
+    gmtime_r(&t, &gmt);
+
+    std::ostringstream oss;
+    oss << m_path << "-" << m_worker << "-" << std::put_time(&gmt, "%Y%m%dT%H%M%SZ") << "-" << m_sequence++
+        << m_extension;
+    std::string file_name = oss.str();
+
+    std::filesystem::path parent = std::filesystem::path(file_name).parent_path();
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent);
+    }
+
+    m_opened = std::chrono::steady_clock::now();
+    return file_name;
+}
+
+bool FileRoller::due(uint64_t bytes) const {
+    if (m_max_bytes && bytes >= m_max_bytes) {
+        return true;
+    }
+    return m_max_age.count() && std::chrono::steady_clock::now() - m_opened >= m_max_age;
+}
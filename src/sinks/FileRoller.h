@@ -0,0 +1,37 @@
+/**
+ * Names and rolls the output files of file based sinks.
+ *
+ * Files are named <path>-<worker>-<UTC timestamp>-<sequence><extension>, so the files of different workers and
+ * restarts never collide. A file is due to be rolled once it has reached max_bytes (default 256 MiB) or has been
+ * open for max_age_s seconds (default 3600); 0 turns either limit off. Sinks only roll at batch boundaries, so a
+ * file can grow slightly beyond max_bytes.
+ **/
+#ifndef FILE_ROLLER_H
+#define FILE_ROLLER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "Sink.h"
+
+class FileRoller {
+   public:
+    FileRoller(SinkConfig config, size_t worker, const std::string &extension);
+    std::string next();
+    bool due(uint64_t bytes) const;
+
+   private:
+    static constexpr uint64_t DEFAULT_MAX_BYTES = 256ull << 20;
+    static constexpr int64_t DEFAULT_MAX_AGE_S = 3600;
+
+    std::string m_path;
+    const size_t m_worker;
+    const std::string m_extension;
+    uint64_t m_max_bytes = DEFAULT_MAX_BYTES;
+    std::chrono::seconds m_max_age{DEFAULT_MAX_AGE_S};
+    std::chrono::steady_clock::time_point m_opened;
+    size_t m_sequence = 0;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "FileSink.h"
+
+#include "logging/Logging.h"
+
+FileSink::FileSink(const std::string &name, size_t worker, SinkConfig config)
+    : m_name(name), m_roller(config, worker, ".ndjson") {
+    if (config.count("buffer_bytes")) {
+        m_buffer_bytes = std::stoul(config["buffer_bytes"]);
+    }
+    m_buffer.reserve(m_buffer_bytes);
+}
+
+void FileSink::write(const SinkRecord &record) {
+    m_buffer.append(record.json);
+    m_buffer.push_back('\n');
+    if (m_buffer.size() < m_buffer_bytes) {
+        return;
+    }
+    if (!m_failed) {
+        write_buffer();
+        return;
+    }
+
+    // Once a write has failed, it is retried on the next flush rather than for every record
+    if (m_buffer.size() >= MAX_BUFFERS * m_buffer_bytes) {
+        LOG_PER_SECOND(ERROR, m_name, 1, "Could not write to '{}', dropping {} bytes", m_file_name, m_buffer.size());
+        m_buffer.clear();
+    }
+}
+
+bool FileSink::write_buffer() {
+    if (m_buffer.empty()) {
+        return true;
+    }
+
+    if (!m_file.is_open()) {
+        m_file_name = m_roller.next();
+        m_file.open(m_file_name, std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+        m_written = 0;
+        if (!m_file) {
+            LOG_PER_SECOND(ERROR, m_name, 1, "Could not open '{}', keeping {} bytes", m_file_name, m_buffer.size());
+            m_file.close();
+            m_file.clear();
+            m_failed = true;
+            return false;
+        }
+        Logging::INFO("Writing to '" + m_file_name + "'", m_name);
+    }
+
+    m_file.write(m_buffer.data(), m_buffer.size());
+    m_written += m_buffer.size();
+    m_buffer.clear();
+    if (m_file.fail()) {
+        fail();
+        return false;
+    }
+    return true;
+}
+
+/*
+What went into the file since it was last flushed may be lost, so it is closed and the next write opens a new one
+*/
+void FileSink::fail() {
+    LOG_PER_SECOND(ERROR, m_name, 1, "Could not write to '{}'", m_file_name);
+    m_file.close();
+    m_file.clear();
+    m_failed = true;
+}
+
+/*
+Also fails if some record could not be written since the last flush
+*/
+bool FileSink::flush() {
+    write_buffer();
+    if (m_file.is_open()) {
+        m_file.flush();
+        if (m_file.fail()) {
+            fail();
+        } else if (m_roller.due(m_written)) {
+            m_file.close();
+        }
+    }
+    bool written = !m_failed;
+    m_failed = false;
+    return written;
+}
+
+FileSink::~FileSink() {
+    write_buffer();
+    m_file.close();
+}
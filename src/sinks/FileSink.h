@@ -0,0 +1,41 @@
+/**
+ * Writes records as newline delimited JSON into local files that are rolled by size and age (see FileRoller).
+ *
+ * Records are collected in a buffer of buffer_bytes (default 1 MiB) and written to the file when it is full or
+ * the sink is flushed. A file is only opened once there is something to write to it. While a file cannot be opened,
+ * the buffer is kept and the open is retried on the next flush, until the buffer holds MAX_BUFFERS times
+ * buffer_bytes and is dropped.
+ **/
+#ifndef FILE_SINK_H
+#define FILE_SINK_H
+
+#include <fstream>
+#include <string>
+
+#include "FileRoller.h"
+#include "Sink.h"
+
+class FileSink : public Sink {
+   public:
+    FileSink(const std::string &name, size_t worker, SinkConfig config);
+    void write(const SinkRecord &record) override;
+    bool flush() override;
+    ~FileSink();
+
+   private:
+    static constexpr size_t DEFAULT_BUFFER_BYTES = 1 << 20;
+    static constexpr size_t MAX_BUFFERS = 4;
+
+    const std::string m_name;
+    FileRoller m_roller;
+    size_t m_buffer_bytes = DEFAULT_BUFFER_BYTES;
+    std::string m_buffer;
+    std::string m_file_name;
+    std::ofstream m_file;
+    uint64_t m_written = 0;
+    bool m_failed = false;  // Some record could not be written since the last flush()
+    bool write_buffer();
+    void fail();
+};
+
+#endif
@@ -0,0 +1,435 @@
+#include "ParquetSink.h"
+
+#include <algorithm>
+#include <avro/Compiler.hh>
+#include <avro/NodeImpl.hh>
+#include <stdexcept>
+
+#include "SchemaRegistry.h"
+#include "logging/Logging.h"
+
+ParquetSink::ParquetSink(const std::string &name, size_t worker, SinkConfig config)
+    : m_name(name), m_worker(worker), m_config(config) {
+    if (config["path"].empty()) {
+        throw std::runtime_error("File based sinks require a 'path'");
+    }
+    if (config.count("row_group_rows")) {
+        m_row_group_rows = std::max<size_t>(1, std::stoul(config["row_group_rows"]));
+    }
+
+    parquet::Compression::type codec = parquet::Compression::SNAPPY;
+    const std::string &compression = config["compression"];
+    if (compression == "zstd") {
+        codec = parquet::Compression::ZSTD;
+    } else if (compression == "gzip") {
+        codec = parquet::Compression::GZIP;
+    } else if (compression == "none") {
+        codec = parquet::Compression::UNCOMPRESSED;
+    } else if (!compression.empty() && compression != "snappy") {
+        throw std::runtime_error("Unknown Parquet compression '" + compression +
+                                 "'. Valid compressions are: snappy, zstd, gzip, none");
+    }
+    m_properties = parquet::WriterProperties::Builder().compression(codec)->build();
+
+    if (!config["schema"].empty()) {
+        m_schema = std::make_unique<avro::ValidSchema>(avro::compileJsonSchemaFromString(config["schema"]));
+        std::vector<Column> columns;
+        std::string errstr;
+        if (!compile_columns(*m_schema, columns, errstr)) {
+            throw std::runtime_error("Parquet sink schema cannot be written: " + errstr);
+        }
+    }
+}
+
+/*
+Maps the fields of a flat record schema to columns. Unions are only allowed between null and one other type.
+*/
+bool ParquetSink::compile_columns(const avro::ValidSchema &schema, std::vector<Column> &columns, std::string &errstr) {
+    const avro::NodePtr &root = schema.root();
+    if (root->type() != avro::AVRO_RECORD) {
+        errstr = "Only record schemas can be written to Parquet";
+        return false;
+    }
+
+    for (size_t i = 0; i < root->leaves(); ++i) {
+        avro::NodePtr field = root->leafAt(i);
+        if (field->type() == avro::AVRO_UNION) {
+            avro::NodePtr value_type;
+            for (size_t b = 0; b < field->leaves(); ++b) {
+                if (field->leafAt(b)->type() == avro::AVRO_NULL) {
+                    continue;
+                }
+                if (value_type) {
+                    errstr = "Field '" + root->nameAt(i) + "' is a union of more than one non-null type";
+                    return false;
+                }
+                value_type = field->leafAt(b);
+            }
+            field = value_type;
+        }
+        if (field && field->type() == avro::AVRO_SYMBOLIC) {
+            field = avro::resolveSymbol(field);
+        }
+
+        Column column{root->nameAt(i)};
+        switch (field ? field->type() : avro::AVRO_NULL) {
+            case avro::AVRO_BOOL:
+                column.type = ColumnType::BOOL;
+                column.builder = std::make_unique<arrow::BooleanBuilder>();
+                break;
+            case avro::AVRO_INT:
+                column.type = ColumnType::INT;
+                column.builder = std::make_unique<arrow::Int32Builder>();
+                break;
+            case avro::AVRO_LONG:
+                column.type = ColumnType::LONG;
+                column.builder = std::make_unique<arrow::Int64Builder>();
+                break;
+            case avro::AVRO_FLOAT:
+                column.type = ColumnType::FLOAT;
+                column.builder = std::make_unique<arrow::FloatBuilder>();
+                break;
+            case avro::AVRO_DOUBLE:
+                column.type = ColumnType::DOUBLE;
+                column.builder = std::make_unique<arrow::DoubleBuilder>();
+                break;
+            case avro::AVRO_STRING:
+            case avro::AVRO_ENUM:
+                column.type = ColumnType::STRING;
+                column.builder = std::make_unique<arrow::StringBuilder>();
+                break;
+            case avro::AVRO_BYTES:
+            case avro::AVRO_FIXED:
+                column.type = ColumnType::BINARY;
+                column.builder = std::make_unique<arrow::BinaryBuilder>();
+                break;
+            default:
+                errstr = "Field '" + column.name + "' has no type that can be written to a column";
+                return false;
+        }
+        columns.push_back(std::move(column));
+    }
+    return true;
+}
+
+/*
+Records that were not decoded with a plan, because the decode mode is not 'plan', are decoded here with a plan of
+the sink's own
+*/
+const FlatRecord *ParquetSink::flat_record(const SinkRecord &record, std::string &errstr) {
+    if (record.flat && record.flat->plan) {
+        return record.flat;
+    }
+
+    auto found = m_plans.find(record.writer_id);
+    if (found == m_plans.end()) {
+        std::shared_ptr<const avro::ValidSchema> schema =
+            SchemaRegistry::instance().schema_for_id(record.writer_id, errstr);
+        std::unique_ptr<DecodePlan> plan = schema ? DecodePlan::compile(*schema, errstr) : nullptr;
+        if (!plan) {
+            Logging::ERROR("Records of schema id " + std::to_string(record.writer_id) +
+                               " cannot be written to Parquet: " + errstr,
+                           m_name);
+        }
+        found = m_plans.emplace(record.writer_id, std::move(plan)).first;
+    }
+    if (!found->second) {
+        errstr = "Schema id " + std::to_string(record.writer_id) + " is not a flat record schema";
+        return nullptr;
+    }
+
+    const uint8_t *payload =
+        static_cast<const uint8_t *>(record.message->payload()) + SchemaRegistry::CP1_FRAMING_SIZE;
+    if (found->second->decode(payload, record.message->len() - SchemaRegistry::CP1_FRAMING_SIZE, m_record, errstr) ==
+        -1) {
+        return nullptr;
+    }
+    return &m_record;
+}
+
+/*
+With a configured schema all records share one output. Otherwise every writer schema gets its own, with its own
+file names.
+*/
+ParquetSink::Output *ParquetSink::output_for(int32_t writer_id, std::string &errstr) {
+    int32_t key = m_schema ? CONFIGURED_SCHEMA : writer_id;
+    auto found = m_outputs.find(key);
+    if (found != m_outputs.end()) {
+        return found->second.get();
+    }
+
+    std::shared_ptr<const avro::ValidSchema> writer_schema;
+    const avro::ValidSchema *schema = m_schema.get();
+    SinkConfig config = m_config;
+    if (!schema) {
+        writer_schema = SchemaRegistry::instance().schema_for_id(writer_id, errstr);
+        if (!writer_schema) {
+            return nullptr;
+        }
+        schema = writer_schema.get();
+        config["path"] += "-" + std::to_string(writer_id);
+    }
+
+    auto output = std::unique_ptr<Output>(new Output{FileRoller(config, m_worker, ".parquet")});
+    if (!compile_columns(*schema, output->columns, errstr)) {
+        return nullptr;
+    }
+
+    arrow::FieldVector fields;
+    for (const Column &column : output->columns) {
+        fields.push_back(arrow::field(column.name, column.builder->type()));
+    }
+    output->schema = arrow::schema(fields);
+
+    return m_outputs.emplace(key, std::move(output)).first->second.get();
+}
+
+/*
+Projections are worked out once per plan, since records of the same plan always have the same fields
+*/
+const std::vector<ssize_t> &ParquetSink::projection(Output &output, const FlatRecord &record) {
+    auto found = output.projections.find(record.plan);
+    if (found == output.projections.end()) {
+        std::vector<ssize_t> indices;
+        for (const Column &column : output.columns) {
+            indices.push_back(record.plan->field_index(column.name));
+        }
+        found = output.projections.emplace(record.plan, std::move(indices)).first;
+    }
+    return found->second;
+}
+
+/*
+Numbers are converted to the type of their column, as Avro's schema resolution would. A value that does not fit
+its column is written as null.
+*/
+arrow::Status ParquetSink::append(Column &column, const FieldValue *value) {
+    if (!value || value->kind == FieldValue::Kind::NUL) {
+        return column.builder->AppendNull();
+    }
+
+    bool number = value->kind == FieldValue::Kind::LONG || value->kind == FieldValue::Kind::FLOAT ||
+                  value->kind == FieldValue::Kind::DOUBLE;
+    bool text = value->kind == FieldValue::Kind::STRING || value->kind == FieldValue::Kind::ENUM ||
+                value->kind == FieldValue::Kind::BYTES;
+    double d = value->kind == FieldValue::Kind::LONG ? static_cast<double>(value->l) : value->d;
+
+    switch (column.type) {
+        case ColumnType::BOOL:
+            if (value->kind == FieldValue::Kind::BOOL) {
+                return static_cast<arrow::BooleanBuilder &>(*column.builder).Append(value->l != 0);
+            }
+            break;
+        case ColumnType::INT:
+            if (value->kind == FieldValue::Kind::LONG) {
+                return static_cast<arrow::Int32Builder &>(*column.builder).Append(static_cast<int32_t>(value->l));
+            }
+            break;
+        case ColumnType::LONG:
+            if (value->kind == FieldValue::Kind::LONG) {
+                return static_cast<arrow::Int64Builder &>(*column.builder).Append(value->l);
+            }
+            break;
+        case ColumnType::FLOAT:
+            if (number) {
+                return static_cast<arrow::FloatBuilder &>(*column.builder).Append(static_cast<float>(d));
+            }
+            break;
+        case ColumnType::DOUBLE:
+            if (number) {
+                return static_cast<arrow::DoubleBuilder &>(*column.builder).Append(d);
+            }
+            break;
+        case ColumnType::STRING:
+            if (text) {
+                return static_cast<arrow::StringBuilder &>(*column.builder).Append(value->s);
+            }
+            break;
+        case ColumnType::BINARY:
+            if (text) {
+                return static_cast<arrow::BinaryBuilder &>(*column.builder).Append(value->s);
+            }
+            break;
+    }
+    return column.builder->AppendNull();
+}
+
+void ParquetSink::write(const SinkRecord &record) {
+    std::string errstr;
+    const FlatRecord *flat = flat_record(record, errstr);
+    if (!flat) {
+        // Like any other record that cannot be decoded, it is skipped
+        ++m_errors;
+        LOG_PER_SECOND(ERROR, m_name, 10, "Could not decode record at offset {} for Parquet: {}",
+                       record.message->offset(), errstr);
+        return;
+    }
+
+    Output *output = output_for(record.writer_id, errstr);
+    if (!output || (!output->writer && !open(*output, errstr))) {
+        ++m_errors;
+        m_failed = true;
+        LOG_PER_SECOND(ERROR, m_name, 10, "Could not write record at offset {} to Parquet: {}",
+                       record.message->offset(), errstr);
+        return;
+    }
+
+    const std::vector<ssize_t> &indices = projection(*output, *flat);
+    for (size_t i = 0; i < output->columns.size(); ++i) {
+        const FieldValue *value = indices[i] < 0 ? nullptr : &flat->fields[indices[i]];
+        arrow::Status status = append(output->columns[i], value);
+        if (!status.ok()) {
+            // Leave the columns of the output at the same length
+            for (size_t j = i + 1; j < output->columns.size(); ++j) {
+                (void)output->columns[j].builder->AppendNull();
+            }
+            m_failed = true;
+            LOG_PER_SECOND(ERROR, m_name, 10, "Could not append to column '{}': {}", output->columns[i].name,
+                           status.ToString());
+            break;
+        }
+    }
+
+    if (++output->rows >= m_row_group_rows && !write_row_group(*output)) {
+        m_failed = true;
+    }
+}
+
+/*
+Finishes the builders into one row group of the open file
+*/
+bool ParquetSink::write_row_group(Output &output) {
+    if (output.rows == 0) {
+        return true;
+    }
+    size_t rows = output.rows;
+    output.rows = 0;
+
+    arrow::ArrayVector arrays;
+    for (Column &column : output.columns) {
+        std::shared_ptr<arrow::Array> array;
+        arrow::Status status = column.builder->Finish(&array);
+        if (!status.ok()) {
+            m_errors += rows;
+            LOG_ERROR(m_name, "Could not build column '{}', dropping {} rows: {}", column.name, rows,
+                      status.ToString());
+            for (Column &c : output.columns) {
+                c.builder->Reset();
+            }
+            return false;
+        }
+        arrays.push_back(std::move(array));
+    }
+
+    std::shared_ptr<arrow::Table> table = arrow::Table::Make(output.schema, arrays, rows);
+    arrow::Status status = output.writer->WriteTable(*table, rows);
+    if (!status.ok()) {
+        m_errors += rows;
+        LOG_ERROR(m_name, "Could not write {} rows to '{}' ({} in total): {}", rows, output.file_name, m_errors,
+                  status.ToString());
+        close(output);
+        return false;
+    }
+    return true;
+}
+
+/*
+Files are opened with the first row that goes into them, which starts the clock for max_age_s
+*/
+bool ParquetSink::open(Output &output, std::string &errstr) {
+    output.file_name = output.roller.next();
+    auto file = arrow::io::FileOutputStream::Open(output.file_name);
+    if (!file.ok()) {
+        errstr = "Could not open '" + output.file_name + "': " + file.status().ToString();
+        return false;
+    }
+    output.file = *file;
+
+    auto writer =
+        parquet::arrow::FileWriter::Open(*output.schema, arrow::default_memory_pool(), output.file, m_properties);
+    if (!writer.ok()) {
+        errstr = "Could not write '" + output.file_name + "': " + writer.status().ToString();
+        (void)output.file->Close();
+        output.file.reset();
+        return false;
+    }
+    output.writer = std::move(*writer);
+    Logging::INFO("Writing to '" + output.file_name + "'", m_name);
+    return true;
+}
+
+bool ParquetSink::close(Output &output) {
+    if (!output.writer) {
+        return true;
+    }
+    arrow::Status status = output.writer->Close();
+    if (status.ok()) {
+        status = output.file->Close();
+    }
+    if (!status.ok()) {
+        LOG_ERROR(m_name, "Could not close '{}': {}", output.file_name, status.ToString());
+    }
+    output.writer.reset();
+    output.file.reset();
+    return status.ok();
+}
+
+/*
+Rows are kept until there are enough for a row group, so that a batch does not end up as a row group of its own.
+Once one file is due to be rolled, every file gets the rows collected so far and is closed, so that the sink holds
+nothing afterwards and the worker can commit what it has written. Also fails if some record could not be written
+since the last flush.
+*/
+bool ParquetSink::flush() {
+    bool due = std::any_of(m_outputs.begin(), m_outputs.end(), [](const auto &output) {
+        if (!output.second->writer) {
+            return false;
+        }
+        auto position = output.second->file->Tell();
+        return output.second->roller.due(position.ok() ? *position : 0);
+    });
+    if (due) {
+        return sync();
+    }
+
+    bool written = !m_failed;
+    m_failed = false;
+    return written;
+}
+
+/*
+The rows of a file cannot be read before its footer has been written when it is closed
+*/
+bool ParquetSink::holds_records() const {
+    return std::any_of(m_outputs.begin(), m_outputs.end(),
+                       [](const auto &output) { return output.second->writer || output.second->rows; });
+}
+
+bool ParquetSink::sync() {
+    bool written = !m_failed;
+    m_failed = false;
+    for (auto &[writer_id, output] : m_outputs) {
+        if (output->writer) {
+            written = write_row_group(*output) && written;
+            written = close(*output) && written;
+        }
+    }
+    return written;
+}
+
+bool ParquetSink::needs_json() const { return false; }
+
+/*
+Nothing is left to write when the worker has synced the sink before stopping; what is left otherwise was never
+reported as durable
+*/
+ParquetSink::~ParquetSink() {
+    bool written = !m_failed;
+    for (auto &[writer_id, output] : m_outputs) {
+        written = write_row_group(*output) && written;
+        written = close(*output) && written;
+    }
+    if (!written) {
+        LOG_ERROR(m_name, "Could not write every record before shutting down ({} errors in total)", m_errors);
+    }
+}
@@ -0,0 +1,91 @@
+/**
+ * Writes records into Parquet files, one column per field of a flat record schema.
+ *
+ * The columns are taken from the Avro record schema given as 'schema' (JSON), which ConfigParser fills in with the
+ * schema assembled for the 'type_map' topic named by the sink's 'type_map' key. Records are projected onto those
+ * columns by field name; fields the record does not have are written as nulls. Without a schema, every writer
+ * schema gets files of its own, named <path>-<schema id>-..., with the columns of that schema.
+ *
+ * Rows are collected in Arrow builders and written as one row group once row_group_rows (default 65536) have been
+ * collected, or when the file is due to be rolled (see FileRoller). Only records that a DecodePlan can decode are
+ * supported; records that were not decoded with a plan are decoded again here from their payload.
+ **/
+#ifndef PARQUET_SINK_H
+#define PARQUET_SINK_H
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <parquet/arrow/writer.h>
+
+#include <avro/ValidSchema.hh>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FileRoller.h"
+#include "Sink.h"
+#include "decode/DecodePlan.h"
+
+class ParquetSink : public Sink {
+   public:
+    ParquetSink(const std::string &name, size_t worker, SinkConfig config);
+    ParquetSink(const ParquetSink &) = delete;
+    void operator=(const ParquetSink &) = delete;
+    void write(const SinkRecord &record) override;
+    bool flush() override;
+    bool holds_records() const override;
+    bool sync() override;
+    bool needs_json() const override;
+    ~ParquetSink();
+
+   private:
+    static constexpr size_t DEFAULT_ROW_GROUP_ROWS = 65536;
+    static constexpr int32_t CONFIGURED_SCHEMA = -1;
+
+    enum class ColumnType { BOOL, INT, LONG, FLOAT, DOUBLE, STRING, BINARY };
+
+    struct Column {
+        std::string name;
+        ColumnType type;
+        std::unique_ptr<arrow::ArrayBuilder> builder;
+    };
+
+    /*
+    The open file of one schema and the rows that have not been written to it yet
+    */
+    struct Output {
+        FileRoller roller;
+        std::vector<Column> columns;
+        std::shared_ptr<arrow::Schema> schema;
+        std::shared_ptr<arrow::io::FileOutputStream> file;
+        std::unique_ptr<parquet::arrow::FileWriter> writer;
+        std::string file_name;
+        size_t rows = 0;
+        // Column i of the output is field projections[plan][i] of records decoded with plan, -1 if it has none
+        std::unordered_map<const DecodePlan *, std::vector<ssize_t>> projections;
+    };
+
+    const std::string m_name;
+    const size_t m_worker;
+    SinkConfig m_config;
+    size_t m_row_group_rows = DEFAULT_ROW_GROUP_ROWS;
+    std::shared_ptr<parquet::WriterProperties> m_properties;
+    std::unique_ptr<avro::ValidSchema> m_schema;
+    std::unordered_map<int32_t, std::unique_ptr<Output>> m_outputs;
+    std::unordered_map<int32_t, std::unique_ptr<DecodePlan>> m_plans;
+    FlatRecord m_record;
+    size_t m_errors = 0;
+    bool m_failed = false;  // Some record could not be written since the last flush() or sync()
+
+    static bool compile_columns(const avro::ValidSchema &schema, std::vector<Column> &columns, std::string &errstr);
+    const FlatRecord *flat_record(const SinkRecord &record, std::string &errstr);
+    Output *output_for(int32_t writer_id, std::string &errstr);
+    const std::vector<ssize_t> &projection(Output &output, const FlatRecord &record);
+    static arrow::Status append(Column &column, const FieldValue *value);
+    bool open(Output &output, std::string &errstr);
+    bool write_row_group(Output &output);
+    bool close(Output &output);
+};
+
+#endif
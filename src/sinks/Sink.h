@@ -0,0 +1,52 @@
+/**
+ * Destination for decoded records.
+ *
+ * Every decode worker owns its own chain of sinks, built from the 'sinks' section of the config by SinkFactory,
+ * so a sink is only ever used by one thread. Sinks are expected to buffer what they are given in write() and to
+ * hand it on in bulk: the worker calls flush() once per consumed batch, and a sink may flush earlier on its own
+ * when its buffer is full.
+ *
+ * Sinks that write files keep what they have written across flushes until the file is complete. They report this
+ * with holds_records(), so that the offsets of those records are not committed yet, and write everything out when
+ * sync() is called. Offsets are only committed after a flush that leaves nothing held, so a sink with several files
+ * rolls all of them once one is due rather than each on its own schedule.
+ **/
+#ifndef SINK_H
+#define SINK_H
+
+#include <librdkafka/rdkafkacpp.h>
+
+#include <map>
+#include <string>
+#include <string_view>
+
+#include "decode/DecodePlan.h"
+
+using SinkConfig = std::map<std::string, std::string>;
+
+/*
+One consumed record. Everything in it is only valid for the duration of the write() call.
+*/
+struct SinkRecord {
+    const RdKafka::Message *message;
+    int32_t writer_id;        // Schema id from the CP1 framing
+    std::string_view json;    // The record as a single line of JSON, without a newline
+    const FlatRecord *flat;   // Set when the record was decoded with a DecodePlan
+};
+
+class Sink {
+   public:
+    virtual ~Sink() {}
+    virtual void write(const SinkRecord &record) = 0;
+    // Hands on everything written so far. Returns false if some of it could not be written.
+    virtual bool flush() = 0;
+    // Whether some records written before the last flush() are not durable yet
+    virtual bool holds_records() const { return false; }
+    // Makes every record written so far durable, including those the sink holds across flushes
+    virtual bool sync() { return flush(); }
+    // Whether the sink reads SinkRecord::json. Sinks that only read the payload are given undecoded records in
+    // passthrough mode.
+    virtual bool needs_json() const { return true; }
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include "SinkFactory.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#include "AvroFileSink.h"
+#include "DatabaseSink.h"
+#include "FanOutSink.h"
+#include "FileSink.h"
+#include "ParquetSink.h"
+#include "StdoutSink.h"
+
+SinkFactory::SinkFactory() {
+    m_creators.emplace("stdout", [](const std::string &name, size_t,
+                                    const SinkConfig &config) -> std::unique_ptr<Sink> {
+        return std::make_unique<StdoutSink>(name, config);
+    });
+    m_creators.emplace("file", [](const std::string &name, size_t worker,
+                                  const SinkConfig &config) -> std::unique_ptr<Sink> {
+        return std::make_unique<FileSink>(name, worker, config);
+    });
+    m_creators.emplace("database", [](const std::string &name, size_t,
+                                      const SinkConfig &config) -> std::unique_ptr<Sink> {
+        return std::make_unique<DatabaseSink>(name, config);
+    });
+    m_creators.emplace("parquet", [](const std::string &name, size_t worker,
+                                     const SinkConfig &config) -> std::unique_ptr<Sink> {
+        return std::make_unique<ParquetSink>(name, worker, config);
+    });
+    m_creators.emplace("avro", [](const std::string &name, size_t worker,
+                                  const SinkConfig &config) -> std::unique_ptr<Sink> {
+        return std::make_unique<AvroFileSink>(name, worker, config);
+    });
+}
+
+std::unique_ptr<Sink> SinkFactory::create(const std::string &name, size_t worker, const SinkConfig &config) const {
+    auto type = config.find("type");
+    if (type == config.end()) {
+        throw std::runtime_error("Sink configuration requires a type of sink.");
+    }
+
+    auto found = m_creators.find(type->second);
+    if (found != m_creators.end()) {
+        return found->second(name, worker, config);
+    }
+
+    std::stringstream ss;
+    std::string sep = "";
+    for (const auto &[type, fct] : m_creators) {
+        ss << sep << type;
+        sep.assign(", ");
+    }
+    throw std::runtime_error("Couldn't produce sink for type: '" + type->second + "'. Valid types are: " + ss.str());
+}
+
+std::unique_ptr<Sink> SinkFactory::create(const std::string &name, size_t worker,
+                                          const std::vector<SinkConfig> &configs) const {
+    if (configs.size() == 1) {
+        return create(name, worker, configs.front());
+    }
+
+    std::vector<std::unique_ptr<Sink>> sinks;
+    for (const SinkConfig &config : configs) {
+        sinks.push_back(create(name, worker, config));
+    }
+    return std::make_unique<FanOutSink>(std::move(sinks));
+}
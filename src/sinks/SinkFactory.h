@@ -0,0 +1,29 @@
+/**
+ * Builds the sinks of a decode worker from the 'sinks' section of the config.
+ *
+ * Every entry of the section needs a 'type'; the other keys are handed to the sink. A worker with several sinks
+ * writes to all of them through a FanOutSink.
+ **/
+#ifndef SINK_FACTORY_H
+#define SINK_FACTORY_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Sink.h"
+
+class SinkFactory {
+    using sink_creator = std::unique_ptr<Sink> (*)(const std::string &name, size_t worker, const SinkConfig &config);
+
+   public:
+    SinkFactory();
+    std::unique_ptr<Sink> create(const std::string &name, size_t worker, const SinkConfig &config) const;
+    std::unique_ptr<Sink> create(const std::string &name, size_t worker, const std::vector<SinkConfig> &configs) const;
+
+   private:
+    std::unordered_map<std::string, sink_creator> m_creators;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "StdoutSink.h"
+
+#include <iostream>
+#include <mutex>
+
+static std::mutex stdout_mutex;
+
+StdoutSink::StdoutSink(const std::string &name, SinkConfig config) : m_name(name) {
+    if (config.count("buffer_bytes")) {
+        m_buffer_bytes = std::stoul(config["buffer_bytes"]);
+    }
+    m_buffer.reserve(m_buffer_bytes);
+}
+
+void StdoutSink::write(const SinkRecord &record) {
+    m_buffer.append(record.json);
+    m_buffer.push_back('\n');
+    if (m_buffer.size() >= m_buffer_bytes && !write_buffer()) {
+        m_failed = true;
+    }
+}
+
+/*
+Also fails if a buffer written by write() could not be written since the last flush
+*/
+bool StdoutSink::flush() {
+    bool written = write_buffer() && !m_failed;
+    m_failed = false;
+    return written;
+}
+
+bool StdoutSink::write_buffer() {
+    if (m_buffer.empty()) {
+        return true;
+    }
+
+    bool written;
+    {
+        std::lock_guard<std::mutex> lock(stdout_mutex);
+        std::cout.write(m_buffer.data(), m_buffer.size());
+        std::cout.flush();
+        written = !std::cout.fail();
+
+        // Let the next buffer try again rather than fail for good
+        std::cout.clear();
+    }
+    m_buffer.clear();
+    return written;
+}
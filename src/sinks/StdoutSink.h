@@ -0,0 +1,31 @@
+/**
+ * Writes records to stdout as newline delimited JSON.
+ *
+ * Records are collected in a buffer that is written with a single call when the sink is flushed, or earlier once
+ * it holds buffer_bytes (default 1 MiB). The workers share one lock around the write so their batches do not
+ * interleave.
+ **/
+#ifndef STDOUT_SINK_H
+#define STDOUT_SINK_H
+
+#include <string>
+
+#include "Sink.h"
+
+class StdoutSink : public Sink {
+   public:
+    StdoutSink(const std::string &name, SinkConfig config);
+    void write(const SinkRecord &record) override;
+    bool flush() override;
+
+   private:
+    static constexpr size_t DEFAULT_BUFFER_BYTES = 1 << 20;
+
+    const std::string m_name;
+    size_t m_buffer_bytes = DEFAULT_BUFFER_BYTES;
+    std::string m_buffer;
+    bool m_failed = false;  // A buffer written by write() could not be written since the last flush()
+    bool write_buffer();
+};
+
+#endif